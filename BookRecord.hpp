@@ -0,0 +1,143 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOOK_RECORD_HPP
+#define BOOK_RECORD_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "Position.hpp"
+#include "MappedFile.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Binary scored positions, a compact alternative to the "position score [best_column]"
+ * text lines read by the opening book generator.
+ *
+ * File format:
+ * - 4 bytes: "C4BR"
+ * - 1 byte: board width
+ * - 1 byte: board height
+ * - 2 bytes: padding (0)
+ * - records of 8 bytes, little endian:
+ *   - bits 0-47: key3() of the position
+ *   - bits 48-53: number of moves of the position
+ *   - bits 54-59: score - MIN_SCORE + 1
+ *   - bits 60-62: 0 if unknown, otherwise 1 + the best column in the orientation of key3(),
+ *                 as in the opening book
+ * Fixed size records need no parsing and can be split into chunks read in parallel.
+ */
+struct BookRecord {
+  static constexpr size_t HEADER_SIZE = 8;
+  static constexpr int KEY_BITS = 48; // enough for the key3() of positions up to 24 moves on a 7x6 board
+
+  static uint64_t key(uint64_t r) {
+    return r & ((uint64_t(1) << KEY_BITS) - 1);
+  }
+
+  static int nbMoves(uint64_t r) {
+    return r >> 48 & 0x3f;
+  }
+
+  static int value(uint64_t r) {
+    return r >> 54 & 0x3f;
+  }
+
+  static int move(uint64_t r) {
+    return r >> 60 & 0x7;
+  }
+
+  /**
+   * @param column: best column to play (0-based), -1 if unknown.
+   * @return the record, 0 if the key3() of the position does not fit in KEY_BITS bits.
+   */
+  static uint64_t encode(const Position &P, int score, int column = -1) {
+    const uint64_t k = P.key3();
+    if(k >> KEY_BITS) return 0;
+    uint64_t move = column < 0 ? 0 : 1 + (P.isKey3Mirrored() ? Position::WIDTH - 1 - column : column);
+    return k | uint64_t(P.nbMoves()) << 48 | uint64_t(score - Position::MIN_SCORE + 1) << 54 | move << 60;
+  }
+};
+
+/**
+ * Write a binary record file.
+ */
+class BookRecordWriter {
+  std::ofstream ofs;
+
+ public:
+  explicit BookRecordWriter(const std::string &filename) : ofs(filename, std::ios::binary) {
+    const char header[BookRecord::HEADER_SIZE] = {'C', '4', 'B', 'R', char(Position::WIDTH), char(Position::HEIGHT), 0, 0};
+    ofs.write(header, BookRecord::HEADER_SIZE);
+  }
+
+  // @return false if the position is too deep to be recorded
+  bool write(const Position &P, int score, int column = -1) {
+    uint64_t r = BookRecord::encode(P, score, column);
+    if(!r) return false;
+    ofs.write(reinterpret_cast<const char *>(&r), sizeof(r));
+    return true;
+  }
+
+  bool ok() const {
+    return !ofs.fail();
+  }
+};
+
+/**
+ * Read-only view of a memory mapped binary record file.
+ */
+class BookRecordFile {
+  MappedFile file;
+  const uint64_t *records;
+  size_t count;
+
+ public:
+  BookRecordFile() : records{0}, count{0} {}
+
+  // @return false if the file cannot be mapped or is not a record file for this board size
+  bool open(const std::string &filename) {
+    records = 0;
+    count = 0;
+    if(!file.open(filename, BookRecord::HEADER_SIZE)) return false;
+    const char *header = static_cast<const char*>(file.get());
+    if(memcmp(header, "C4BR", 4) || header[4] != Position::WIDTH || header[5] != Position::HEIGHT) {
+      file.close();
+      return false;
+    }
+    records = reinterpret_cast<const uint64_t*>(header + BookRecord::HEADER_SIZE);
+    count = (file.size() - BookRecord::HEADER_SIZE) / sizeof(uint64_t);
+    return true;
+  }
+
+  const uint64_t* data() const {
+    return records;
+  }
+
+  size_t size() const {
+    return count;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
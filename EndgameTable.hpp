@@ -0,0 +1,64 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENDGAME_TABLE_HPP
+#define ENDGAME_TABLE_HPP
+
+#include <iostream>
+#include "Position.hpp"
+#include "MappedTable.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Endgame tablebase: exact scores of positions having few empty cells.
+ *
+ * Positions are identified by their symmetricKey() as key3() overflows close to
+ * the end of the game. Values are encoded as in the opening book:
+ * score - MIN_SCORE + 1, 0 meaning the position is not stored.
+ * The table file is generated by the tablebase tool, see tablebase.cpp.
+ */
+class EndgameTable {
+  static_assert(Position::WIDTH * (Position::HEIGHT + 1) <= 64, "Endgame table keys are limited to 64 bits");
+
+  MappedTable T;
+  int min_moves; // only positions with at least min_moves played moves are stored
+
+ public:
+  EndgameTable() : min_moves{Position::WIDTH * Position::HEIGHT + 1} {} // Empty table
+
+  void load(const std::string &filename) {
+    min_moves = Position::WIDTH * Position::HEIGHT + 1;
+    int max_empty;
+    if(T.load(filename, Position::WIDTH, Position::HEIGHT, max_empty)) {
+      min_moves = Position::WIDTH * Position::HEIGHT - max_empty;
+      std::cerr << "Loaded endgame table from file: " << filename << " (" << T.getSize()
+                << " positions, " << max_empty << " empty cells)" << std::endl;
+    }
+  }
+
+  int get(const Position &P) const {
+    if(P.nbMoves() < min_moves) return 0;
+    else return T.get(P.symmetricKey());
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
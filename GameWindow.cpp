@@ -2,7 +2,10 @@
 #include <iostream>
 
 GameWindow::GameWindow()
-    : window(sf::VideoMode(700, 600), "Connect 4"), playerTurn(true) {
+    : window(sf::VideoMode(700, 600), "Connect 4"), evalSearch(solver), playerTurn(true), evalScore(0), evalMoves(-1), dirty(true), pulsing(false),
+      aiSearch(solver), aiColumn(-1), aiBookMove(-1), aiThinking(false) {
+    window.setFramerateLimit(FRAME_RATE_LIMIT);
+
     // Load font for status text
     if (!font.loadFromFile("assets/fonts/DejaVuSansMono.ttf")) {
         std::cerr << "Error loading font!" << std::endl;
@@ -35,6 +38,7 @@ GameWindow::GameWindow()
     // Initialize solver
     solver.reset(); // Reset the solver's state
     solver.loadBook("7x6.book"); // Load an opening book (optional)
+    solver.loadEndgameTable("7x6.endgame"); // Load an endgame table (optional)
 
     playerTurn = showStartMenu();
     gameOver = false; // initialize gameOver flag
@@ -49,6 +53,9 @@ void GameWindow::resetGame(bool playerGoesFirst) {
     position = GameSolver::Connect4::Position();
     gameOver = false;
     playerTurn = playerGoesFirst;
+    evalMoves = -1; // evaluate the new game
+    drop.active = false;
+    aiThinking = false;
 
     if (!playerTurn) {
         aiMove();
@@ -141,39 +148,89 @@ bool GameWindow::showStartMenu() {
     return true; // Default to player first if window is closed
 }
 
+// Redraw only when something changed, and sleep in waitEvent while there is nothing to compute or animate
 void GameWindow::run() {
     while (window.isOpen()) {
+        if (!busy()) {
+            sf::Event event;
+            if (window.waitEvent(event)) {
+                handleEvent(event);
+            }
+        }
         processEvents();
         update();
-        render();
+        if (dirty && window.isOpen()) {
+            render(); // display() waits for the frame rate limit
+        }
     }
 }
 
+bool GameWindow::busy() const {
+    bool evaluating = !gameOver && (position.nbMoves() != evalMoves || !evalSearch.done());
+    bool aiPending = !gameOver && (aiThinking || !playerTurn);
+    return evaluating || aiPending || drop.active || pulsing;
+}
+
 // Modified processEvents to allow resetting the game when over
 void GameWindow::processEvents() {
     sf::Event event;
     while (window.pollEvent(event)) {
-        if (event.type == sf::Event::Closed) {
-            window.close();
-        } else if (event.type == sf::Event::MouseButtonPressed) {
-            if (gameOver) {
-                // Reset the game on click if game is over
-                bool playerGoesFirst = showStartMenu();
-                resetGame(playerGoesFirst);
-            } else if (playerTurn && event.mouseButton.button == sf::Mouse::Left) {
-                int column = event.mouseButton.x / cellWidth; 
-                handlePlayerMove(column);
-            }
+        handleEvent(event);
+    }
+}
+
+void GameWindow::handleEvent(const sf::Event &event) {
+    if (event.type == sf::Event::Closed) {
+        window.close();
+    } else if (event.type == sf::Event::Resized || event.type == sf::Event::GainedFocus) {
+        dirty = true; // the window content may have been lost
+    } else if (event.type == sf::Event::MouseButtonPressed) {
+        if (gameOver) {
+            // Reset the game on click if game is over
+            bool playerGoesFirst = showStartMenu();
+            resetGame(playerGoesFirst);
+        } else if (playerTurn && !drop.active && event.mouseButton.button == sf::Mouse::Left) {
+            int column = event.mouseButton.x / cellWidth; 
+            handlePlayerMove(column);
         }
+        dirty = true;
     }
 }
 
-// Modified update to skip evaluation updates during game over
+// Advance the animation, the AI analysis and the evaluation bar search, skipped during game over
 void GameWindow::update() {
     if (gameOver) return;
+    if (drop.active) {
+        float duration = DROP_TIME_PER_ROW * (GameSolver::Connect4::Position::HEIGHT - drop.row);
+        if (drop.clock.getElapsedTime().asSeconds() >= duration) {
+            finishAnimation();
+            if (gameOver) return;
+        } else {
+            dirty = true; // next frame of the animation
+        }
+    }
+    if (aiThinking) {
+        stepAiSearch(AI_STEP_NODES);
+    } else if (!playerTurn && !drop.active && !gameOver) {
+        playAiMove(); // the analysis is done and the player's disc has landed
+    }
+    if (position.nbMoves() != evalMoves) {
+        // The score of the previous position is a close guess, once its sign is flipped if the
+        // player to move changed. It is displayed until the search of the new position completes
+        if (evalMoves < 0) evalScore = 0;
+        else if ((position.nbMoves() - evalMoves) % 2) evalScore = -evalScore;
+        evalMoves = position.nbMoves();
+        evalSearch.startWithGuess(position, evalScore);
+        dirty = true;
+    }
+    if (!evalSearch.done() && evalSearch.step(EVAL_STEP_NODES)) {
+        evalScore = evalSearch.result();
+        dirty = true;
+    }
 }
 
 void GameWindow::render() {
+    dirty = false;
     window.clear(sf::Color::Blue);
 
     int boardCols = GameSolver::Connect4::Position::WIDTH;
@@ -183,6 +240,9 @@ void GameWindow::render() {
         int posRow = boardRows - 1 - drawRow;
         for (int col = 0; col < boardCols; ++col) {
             int cell = position.getCell(posRow, col);
+            if (drop.active && posRow == drop.row && col == drop.column) {
+                cell = 0; // the disc is still falling
+            }
             if (cell == 1) {
                 boardCells[drawRow][col].setFillColor(sf::Color::Red);
             } else if (cell == 2) {
@@ -194,9 +254,24 @@ void GameWindow::render() {
         }
     }
 
-    // In the render() method, replace the evaluation bar code:
+    if (drop.active) {
+        // Fall from above the board with a constant acceleration
+        float duration = DROP_TIME_PER_ROW * (boardRows - drop.row);
+        float t = std::min(1.f, drop.clock.getElapsedTime().asSeconds() / duration);
+        float startY = topMargin - cellHeight;
+        float endY = topMargin + (boardRows - 1 - drop.row) * cellHeight;
+        sf::RectangleShape disc(sf::Vector2f(cellWidth, cellHeight));
+        disc.setFillColor(drop.color);
+        disc.setOutlineThickness(2);
+        disc.setOutlineColor(sf::Color::Black);
+        disc.setPosition(drop.column * cellWidth, startY + (endY - startY) * t * t);
+        window.draw(disc);
+    }
+
+    // Evaluation bar, the score is computed by update()
+    pulsing = false;
     if (!gameOver) {
-        int score = solver.solve(position);
+        int score = evalScore;
         float maxScore = 42.f; // Maximum theoretical score
         float barWidth = 500.f;
         float barHeight = 20.f;
@@ -231,6 +306,7 @@ void GameWindow::render() {
             // Add pulsing effect for near-win
             float pulse = (1 + std::sin(animationClock.getElapsedTime().asSeconds() * 5)) / 2;
             leftColor.a = 128 + static_cast<sf::Uint8>(127 * pulse);
+            pulsing = true;
         }
         leftBar.setFillColor(leftColor);
         leftBar.setPosition(barX, barY);
@@ -244,6 +320,7 @@ void GameWindow::render() {
             // Add pulsing effect for near-win
             float pulse = (1 + std::sin(animationClock.getElapsedTime().asSeconds() * 5)) / 2;
             rightColor.a = 128 + static_cast<sf::Uint8>(127 * pulse);
+            pulsing = true;
         }
         rightBar.setFillColor(rightColor);
         rightBar.setPosition(barX + centerWidth, barY);
@@ -286,6 +363,7 @@ void GameWindow::render() {
     window.draw(statusText);
 
     window.display();
+    if (pulsing) dirty = true; // keep animating the evaluation bar
 }
 
 // Modified handlePlayerMove to stop processing moves when gameOver is true 
@@ -295,7 +373,7 @@ void GameWindow::handlePlayerMove(int column) {
     if (column < 0 || column >= boardCols || !position.canPlay(column)) {
         return; // Invalid move
     }
-    if (gameOver) return; // ignore moves if game is already over
+    if (gameOver || drop.active) return; // ignore moves if game is already over or a disc is falling
     // Compute final row for the move
     int finalRow = 0;
     while(finalRow < boardRows &&
@@ -303,27 +381,65 @@ void GameWindow::handlePlayerMove(int column) {
         finalRow++;
     }
 
-    // animateMove(column, finalRow, sf::Color::Red);
     position.playCol(column); 
-    checkGameOver(column);    // Check if the game is over
-    if (!gameOver) {
-        playerTurn = false;       // Switch to AI's turn
-        aiMove();
+    animateMove(column, finalRow, position.getCell(finalRow, column) == 1 ? sf::Color::Red : sf::Color::Yellow);
+    if (!position.wins() && position.nbMoves() < boardCols * boardRows) {
+        aiMove(); // the AI analysis runs while the disc is falling
     }
+    // game over and turn switch are checked at the end of the animation
 }
 
-// Modified aiMove so that if a win occurs during the AI move, it does not switch back turn
+// Start the analysis of the AI move, it is advanced by update()
 void GameWindow::aiMove() {
     if (gameOver) return;
-    // Analyze all possible moves
-    std::vector<int> scores = solver.analyze(position);
+    aiPosition = position;
+    aiScores.assign(GameSolver::Connect4::Position::WIDTH, GameSolver::Connect4::Solver::INVALID_MOVE);
+    aiColumn = -1;
+    aiBookMove = solver.bookMove(position); // no search in book depth
+    aiThinking = aiBookMove < 0;
+}
+
+// Same as Solver::analyze, split in steps of about maxNodes nodes
+void GameWindow::stepAiSearch(unsigned long long maxNodes) {
+    int boardCols = GameSolver::Connect4::Position::WIDTH;
+    int boardRows = GameSolver::Connect4::Position::HEIGHT;
+    unsigned long long limit = aiSearch.getNodeCount() + maxNodes;
+    while (aiThinking && aiSearch.getNodeCount() < limit) {
+        if (aiColumn >= 0 && !aiSearch.done()) {
+            if (aiSearch.step(limit - aiSearch.getNodeCount())) {
+                aiScores[aiColumn] = -aiSearch.result();
+            }
+            continue;
+        }
+        // move to the next column
+        do {
+            aiColumn++;
+        } while (aiColumn < boardCols && !aiPosition.canPlay(aiColumn));
+        if (aiColumn >= boardCols) {
+            aiThinking = false;
+            evaluateState(aiScores);
+        } else if (aiPosition.isWinningMove(aiColumn)) {
+            aiScores[aiColumn] = (boardCols * boardRows + 1 - aiPosition.nbMoves()) / 2;
+        } else {
+            GameSolver::Connect4::Position P2(aiPosition);
+            P2.playCol(aiColumn);
+            aiSearch.start(P2);
+            if (aiSearch.done()) { // solved without search, e.g. the opponent can win next move
+                aiScores[aiColumn] = -aiSearch.result();
+            }
+        }
+    }
+}
+
+// Play the best analyzed move, the turn is switched at the end of its animation
+void GameWindow::playAiMove() {
     // Find the best move
-    int bestMove = -1;
+    int bestMove = aiBookMove;
     int bestScore = GameSolver::Connect4::Solver::INVALID_MOVE;
     int boardCols = GameSolver::Connect4::Position::WIDTH;
-    for (int col = 0; col < boardCols; ++col) {
-        if (scores[col] > bestScore) {
-            bestScore = scores[col];
+    for (int col = 0; col < boardCols && aiBookMove < 0; ++col) {
+        if (aiScores[col] > bestScore) {
+            bestScore = aiScores[col];
             bestMove = col;
         }
     }
@@ -335,12 +451,9 @@ void GameWindow::aiMove() {
               position.getCell(finalRow, bestMove) != 0) {
             finalRow++;
         }
-        // animateMove(bestMove, finalRow, sf::Color::Yellow);
         position.playCol(bestMove);
-        checkGameOver(bestMove); // Check game over after AI's move
+        animateMove(bestMove, finalRow, position.getCell(finalRow, bestMove) == 1 ? sf::Color::Red : sf::Color::Yellow);
     }
-    if (!gameOver)
-        playerTurn = true; // Switch back to the player's turn if game not over
 }
 
 // Modified checkGameOver signature and updated logic
@@ -351,8 +464,6 @@ void GameWindow::checkGameOver([[maybe_unused]] int lastColumn) {
         gameOver = true;
         // Render the final move before showing the pop-up
         render();
-        window.display();
-        sf::sleep(sf::milliseconds(200));
         showEndGamePopup(statusText.getString()); // Use end-game pop-up
         return;
     }
@@ -370,17 +481,32 @@ void GameWindow::checkGameOver([[maybe_unused]] int lastColumn) {
         gameOver = true;
         // Render the final move before showing the pop-up
         render();
-        window.display();
-        sf::sleep(sf::milliseconds(200));
         showEndGamePopup("Game Tied!");
         return;
     }
-    evaluateState(); 
 }
 
 
 void GameWindow::animateMove(int column, int finalRow, sf::Color discColor) {
-    // Animate the disc falling down
+    // Animate the disc falling down, driven by update() and render()
+    drop.active = true;
+    drop.column = column;
+    drop.row = finalRow;
+    drop.color = discColor;
+    drop.clock.restart();
+    dirty = true;
+}
+
+// End of a drop animation: check the end of the game and switch turns
+void GameWindow::finishAnimation() {
+    drop.active = false;
+    dirty = true;
+    int nbCells = GameSolver::Connect4::Position::WIDTH * GameSolver::Connect4::Position::HEIGHT;
+    if (position.wins() || position.nbMoves() == nbCells) {
+        checkGameOver(drop.column); // the end game pop-up may start a new game
+    } else {
+        playerTurn = !playerTurn;
+    }
 }
 
 
@@ -390,9 +516,7 @@ void GameWindow::showNotification(const std::string& message) {
     // Create notification text
 }
 
-void GameWindow::evaluateState() {
-    std::vector<int> scores = solver.analyze(position);
-    
+void GameWindow::evaluateState(const std::vector<int> &scores) {
     // Create evaluation text
     std::string eval = "Column scores:";
     for (int i = 0; i < GameSolver::Connect4::Position::WIDTH; i++) {
@@ -4,6 +4,7 @@
 #include <SFML/Graphics.hpp>
 #include "Position.hpp"
 #include "Solver.hpp"
+#include "StepSolver.hpp"
 
 class GameWindow {
 public:
@@ -18,8 +19,34 @@ private:
 
     GameSolver::Connect4::Position position;
     GameSolver::Connect4::Solver solver;
+    GameSolver::Connect4::StepSolver evalSearch; // evaluation bar search, advanced a little every frame
     bool playerTurn; 
     bool gameOver; 
+    int evalScore;  // evaluation bar score, used as a guess for the next evaluation
+    int evalMoves;  // number of moves of the evaluated position, -1 if none
+    static constexpr unsigned long long EVAL_STEP_NODES = 20000; // nodes explored per frame for the evaluation bar
+    static constexpr unsigned int FRAME_RATE_LIMIT = 60;
+    bool dirty;    // the window content is outdated and must be rendered
+    bool pulsing;  // the evaluation bar is animated
+
+    // Disc falling to its cell, the move is already played in position
+    struct DropAnimation {
+        bool active = false;
+        int column = 0;
+        int row = 0;       // final row, 0 is the bottom row
+        sf::Color color;
+        sf::Clock clock;   // started with the animation
+    } drop;
+    static constexpr float DROP_TIME_PER_ROW = 0.06f; // seconds for the disc to fall by one row
+
+    // AI analysis of all the columns, advanced a little every frame
+    GameSolver::Connect4::StepSolver aiSearch;
+    GameSolver::Connect4::Position aiPosition; // analyzed position
+    std::vector<int> aiScores;
+    int aiColumn;     // column being solved, -1 before the first one
+    int aiBookMove;   // move given by the opening book, -1 if the position has to be analyzed
+    bool aiThinking;  // the analysis is running
+    static constexpr unsigned long long AI_STEP_NODES = 50000; // nodes explored per frame for the AI move
 
 
     bool showStartMenu(); // Returns true if player wants to go first
@@ -31,16 +58,21 @@ private:
     float cellHeight; 
 
     void processEvents();
+    void handleEvent(const sf::Event &event);
+    bool busy() const;    // an evaluation or an animation is running, the loop must not block on events
     void update();        
     void render();       
     void handlePlayerMove(int column); 
-    void aiMove();                     
+    void aiMove();                     // start the analysis for the AI move
+    void stepAiSearch(unsigned long long maxNodes);
+    void playAiMove();                 // play the best move once analyzed
     void checkGameOver([[maybe_unused]] int lastColumn); 
 
     // Animation and notification functions
-    void animateMove(int column, int finalRow, sf::Color discColor);
+    void animateMove(int column, int finalRow, sf::Color discColor); // start a drop animation
+    void finishAnimation();
     void showNotification(const std::string &message); 
-    void evaluateState();
+    void evaluateState(const std::vector<int> &scores);
     void showEndGamePopup(const std::string &message);
 
     void updateButtonHover(sf::RectangleShape& button, const sf::Vector2i& mousePos);
@@ -0,0 +1,226 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include "MCTSEngine.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+void MCTSEngine::run(Worker &w) {
+  uint32_t path[Position::WIDTH * Position::HEIGHT + 1]; // nodes from the root to the leaf of an iteration
+  unsigned int iterations = 0;
+  while(!stop.load(std::memory_order_relaxed)) {
+    unsigned long long left = remaining.load(std::memory_order_relaxed);
+    do {
+      if(left == 0) {
+        stop.store(true, std::memory_order_relaxed);
+        return;
+      }
+    } while(!remaining.compare_exchange_weak(left, left - 1, std::memory_order_relaxed));
+
+    // selection and expansion
+    Position P(root);
+    uint32_t index = 0;
+    int depth = 0;
+    bool expanded = false; // only one leaf is expanded per iteration
+    int result;            // result of the game for the current player of P, in half points
+    while(true) {
+      Node &node = tree[index];
+      node.visits.fetch_add(VIRTUAL_LOSS, std::memory_order_relaxed);
+      path[depth++] = index;
+      uint8_t state = node.state.load(std::memory_order_acquire);
+      if(state == UNEXPANDED && !expanded && !treeFull.load(std::memory_order_relaxed) && expand(node, P)) {
+        expanded = true;
+        state = node.state.load(std::memory_order_relaxed);
+      }
+      if(state == TERMINAL) {
+        result = 2 - node.outcome;
+        break;
+      }
+      if(state != EXPANDED) { // new leaf, or another thread is expanding it
+        result = playout(w, P);
+        break;
+      }
+      index = select(node);
+      P.playCol(tree[index].column);
+    }
+    w.playouts++;
+
+    // backpropagation, replacing the virtual losses by the result
+    while(depth--) {
+      Node &node = tree[path[depth]];
+      node.score.fetch_add(2 - result, std::memory_order_relaxed);
+      node.visits.fetch_add(1 - VIRTUAL_LOSS, std::memory_order_relaxed);
+      result = 2 - result;
+    }
+
+    if(tree[0].visits.load(std::memory_order_relaxed) >= MAX_VISITS ||
+       (timeLimited && (++iterations & CLOCK_CHECK_PERIOD) == 0 && std::chrono::steady_clock::now() >= deadline))
+      stop.store(true, std::memory_order_relaxed);
+  }
+}
+
+bool MCTSEngine::expand(Node &node, const Position &P) {
+  uint8_t expected = UNEXPANDED;
+  if(!node.state.compare_exchange_strong(expected, EXPANDING, std::memory_order_acquire)) return false;
+
+  Position::position_t moves = 0;
+  if(P.canWinNext()) node.outcome = 0;                                          // the player to move wins
+  else if(P.nbMoves() == Position::WIDTH * Position::HEIGHT) node.outcome = 1;  // draw game
+  else if((moves = P.possibleNonLosingMoves()) == 0) node.outcome = 2;          // the opponent wins next move
+  if(moves == 0) {
+    node.state.store(TERMINAL, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t nbChildren = 0;
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(moves & Position::column_mask(col)) nbChildren++;
+  const uint32_t first = nbNodes.fetch_add(nbChildren, std::memory_order_relaxed);
+  if(first + nbChildren > capacity) {
+    treeFull.store(true, std::memory_order_relaxed);
+    node.state.store(UNEXPANDED, std::memory_order_release);
+    return false;
+  }
+
+  uint32_t index = first;
+  for(int i = 0; i < Position::WIDTH; i++)
+    if(moves & Position::column_mask(columnOrder[i])) {
+      Node &child = tree[index++];
+      child.visits.store(0, std::memory_order_relaxed);
+      child.score.store(0, std::memory_order_relaxed);
+      child.children.store(0, std::memory_order_relaxed);
+      child.state.store(UNEXPANDED, std::memory_order_relaxed);
+      child.column = columnOrder[i];
+      child.nbChildren = 0;
+      child.outcome = 0;
+    }
+  node.nbChildren = nbChildren;
+  node.children.store(first, std::memory_order_relaxed);
+  node.state.store(EXPANDED, std::memory_order_release);
+  return true;
+}
+
+uint32_t MCTSEngine::select(const Node &node) const {
+  const uint32_t first = node.children.load(std::memory_order_relaxed);
+  const double logVisits = std::log(double(node.visits.load(std::memory_order_relaxed)));
+  uint32_t best = first;
+  double bestValue = -1;
+  for(uint32_t i = first; i < first + node.nbChildren; i++) {
+    const Node &child = tree[i];
+    if(child.state.load(std::memory_order_acquire) == TERMINAL && child.outcome == 2) return i; // winning move
+    const uint32_t visits = child.visits.load(std::memory_order_relaxed);
+    if(visits == 0) return i; // unvisited children first
+    const double value = child.score.load(std::memory_order_relaxed) / (2.0 * visits) + EXPLORATION * std::sqrt(logVisits / visits);
+    if(value > bestValue) {
+      bestValue = value;
+      best = i;
+    }
+  }
+  return best;
+}
+
+int MCTSEngine::playout(Worker &w, Position P) const {
+  for(int turn = 0;; turn ^= 1) { // turn is 1 when the opponent of the initial player is to play
+    if(P.nbMoves() == Position::WIDTH * Position::HEIGHT) return 1;
+    Position::position_t moves;
+    if(policy == Playout::HEURISTIC) {
+      if(P.canWinNext()) return turn ? 0 : 2;
+      moves = P.possibleNonLosingMoves();
+      if(moves == 0) return turn ? 2 : 0;
+    }
+    else moves = P.possible();
+    P.play(moves & Position::column_mask(randomColumn(w, moves)));
+    if(policy == Playout::RANDOM && P.wins()) return turn ? 0 : 2;
+  }
+}
+
+int MCTSEngine::randomColumn(Worker &w, Position::position_t moves) {
+  int columns[Position::WIDTH];
+  int n = 0;
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(moves & Position::column_mask(col)) columns[n++] = col;
+  return columns[w.random() % n];
+}
+
+std::vector<MCTSEngine::MoveStats> MCTSEngine::analyze(const Position &P, const Limits &limits) {
+  std::vector<MoveStats> stats(Position::WIDTH, MoveStats{0, INVALID_VALUE});
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(P.canPlay(col)) stats[col].value = P.isWinningMove(col) ? 1 : 0;
+  treeSize = 0;
+  if(P.canWinNext() || P.possibleNonLosingMoves() == 0) return stats; // nothing to search
+
+  root = P;
+  Node &r = tree[0];
+  r.visits.store(0, std::memory_order_relaxed);
+  r.score.store(0, std::memory_order_relaxed);
+  r.children.store(0, std::memory_order_relaxed);
+  r.state.store(UNEXPANDED, std::memory_order_relaxed);
+  r.nbChildren = 0;
+  nbNodes.store(1, std::memory_order_relaxed);
+  treeFull.store(false, std::memory_order_relaxed);
+  stop.store(false, std::memory_order_relaxed);
+  remaining.store(limits.playouts ? limits.playouts : ULLONG_MAX, std::memory_order_relaxed);
+  timeLimited = limits.milliseconds > 0;
+  deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.milliseconds);
+  for(auto &w : workers) w.playouts = 0;
+
+  std::vector<std::thread> helpers;
+  for(size_t i = 1; i < workers.size(); i++) helpers.emplace_back(&MCTSEngine::run, this, std::ref(workers[i]));
+  run(workers[0]);
+  for(auto &t : helpers) t.join();
+
+  for(auto &w : workers) playoutCount += w.playouts;
+  treeSize = std::min(nbNodes.load(std::memory_order_relaxed), capacity);
+  if(r.state.load(std::memory_order_relaxed) == EXPANDED) {
+    const uint32_t first = r.children.load(std::memory_order_relaxed);
+    for(uint32_t i = first; i < first + r.nbChildren; i++) {
+      const uint32_t visits = tree[i].visits.load(std::memory_order_relaxed);
+      stats[tree[i].column].visits = visits;
+      if(visits) stats[tree[i].column].value = tree[i].score.load(std::memory_order_relaxed) / (2.0 * visits);
+    }
+  }
+  return stats;
+}
+
+int MCTSEngine::bestMove(const Position &P, const Limits &limits) {
+  const std::vector<MoveStats> stats = analyze(P, limits);
+  int best = -1;
+  for(int i = 0; i < Position::WIDTH; i++) { // ties are broken towards the center
+    const int col = columnOrder[i];
+    if(stats[col].value == INVALID_VALUE) continue;
+    if(best < 0 || stats[col].visits > stats[best].visits ||
+       (stats[col].visits == stats[best].visits && stats[col].value > stats[best].value)) best = col;
+  }
+  return best;
+}
+
+MCTSEngine::MCTSEngine(unsigned int nbThreads, Playout playout, int treeSizeLog) :
+  policy{playout}, capacity{uint32_t(1) << std::min(std::max(treeSizeLog, 4), 30)}, tree{new Node[capacity]},
+  nbNodes{0}, treeFull{false}, workers(nbThreads < 1 ? 1 : nbThreads),
+  timeLimited{false}, remaining{0}, stop{false}, playoutCount{0}, treeSize{0} {
+  for(int i = 0; i < Position::WIDTH; i++) // initialize the column order, starting with center columns
+    columnOrder[i] = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+  for(size_t i = 0; i < workers.size(); i++) workers[i].seed = UINT64_C(0x9E3779B97F4A7C15) * (i + 1);
+}
+
+} // namespace Connect4
+} // namespace GameSolver
@@ -0,0 +1,173 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MCTS_ENGINE_HPP
+#define MCTS_ENGINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Position.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Monte-Carlo tree search (UCT) engine, choosing moves under a time or playout
+ * budget on boards too large to be solved by Solver.
+ *
+ * All the threads share one tree (tree parallelization): each iteration walks
+ * down from the root selecting children by UCT, expands the reached leaf,
+ * runs a playout to the end of the game and propagates its result back to the
+ * root. A thread walking through a node adds a virtual loss to it until the
+ * result is propagated, so that concurrent threads spread over different lines.
+ *
+ * Nodes are allocated from a fixed size pool, once it is full the leaves are
+ * no longer expanded and only get more playouts. Moves losing at once are never
+ * added to the tree and positions decided within one move are scored exactly.
+ */
+class MCTSEngine {
+ public:
+  // Move selection policy of the playouts
+  enum class Playout {
+    RANDOM,    // uniformly random playable columns
+    HEURISTIC  // win at once when possible, otherwise random moves among the ones not losing at once
+  };
+
+  // Search budget, a null value means no limit. The search stops as soon as one of the limits is reached.
+  struct Limits {
+    unsigned int milliseconds = 1000;
+    unsigned long long playouts = 0;
+  };
+
+  // Search result of a column
+  struct MoveStats {
+    unsigned long long visits; // number of playouts through the move
+    double value;              // mean result of the move for the current player: 1 win, 0.5 draw, 0 loss,
+                               // INVALID_VALUE for unplayable columns
+  };
+
+  static constexpr double INVALID_VALUE = -1;
+
+ private:
+  static constexpr double EXPLORATION = 1.4;      // UCT exploration constant
+  static constexpr uint32_t VIRTUAL_LOSS = 3;     // visits added without score while a thread goes through a node
+  static constexpr uint32_t MAX_VISITS = 1 << 30; // stop before overflowing the score of the root
+  static constexpr unsigned CLOCK_CHECK_PERIOD = 63; // check the time every 64 iterations
+
+  // Node states
+  static constexpr uint8_t UNEXPANDED = 0;
+  static constexpr uint8_t EXPANDING = 1; // a thread is creating the children
+  static constexpr uint8_t EXPANDED = 2;
+  static constexpr uint8_t TERMINAL = 3;  // the result of the position is known, see outcome
+
+  /**
+   * Results are counted in half points: 2 for a win, 1 for a draw, 0 for a loss,
+   * always for the player who played the move leading to the node.
+   */
+  struct Node {
+    std::atomic<uint32_t> visits;   // completed playouts through the node, plus the virtual losses in progress
+    std::atomic<uint32_t> score;    // sum of the results of the completed playouts
+    std::atomic<uint32_t> children; // index of the first child, valid once EXPANDED
+    std::atomic<uint8_t> state;
+    uint8_t column;     // column played from the parent
+    uint8_t nbChildren;
+    uint8_t outcome;    // result of a TERMINAL node
+  };
+
+  struct alignas(64) Worker {
+    uint64_t seed; // xorshift random generator state, never 0
+    unsigned long long playouts = 0;
+
+    uint64_t random() {
+      seed ^= seed >> 12;
+      seed ^= seed << 25;
+      seed ^= seed >> 27;
+      return seed * UINT64_C(0x2545F4914F6CDD1D);
+    }
+  };
+
+  const Playout policy;
+  const uint32_t capacity;
+  std::unique_ptr<Node[]> tree; // node 0 is the root
+  std::atomic<uint32_t> nbNodes;
+  std::atomic<bool> treeFull;
+  std::vector<Worker> workers; // worker 0 is the thread calling analyze
+  int columnOrder[Position::WIDTH]; // order of the children, starting with center columns
+
+  // state of the current search
+  Position root;
+  bool timeLimited;
+  std::chrono::steady_clock::time_point deadline;
+  std::atomic<unsigned long long> remaining; // playouts left to start
+  std::atomic<bool> stop;
+
+  unsigned long long playoutCount;
+  unsigned int treeSize;
+
+  // Run search iterations until the search is stopped
+  void run(Worker &w);
+
+  // Create the children of a leaf or find out that its position is terminal, returns false if the tree is full
+  bool expand(Node &node, const Position &P);
+
+  // Child of an expanded node maximizing the UCT value
+  uint32_t select(const Node &node) const;
+
+  // Play a game to its end, returns its result for the current player of P in half points
+  int playout(Worker &w, Position P) const;
+
+  // Random column among the ones of a non empty bitmap of moves
+  static int randomColumn(Worker &w, Position::position_t moves);
+
+ public:
+  /**
+   * Search a position and return the results of each column.
+   * A move winning at once gets value 1 and moves losing at once value 0, both without playouts.
+   */
+  std::vector<MoveStats> analyze(const Position &P, const Limits &limits);
+
+  // Returns the most visited column (0-based) after a search, -1 if no move is possible
+  int bestMove(const Position &P, const Limits &limits);
+
+  // Number of playouts run since construction
+  unsigned long long getPlayoutCount() const {
+    return playoutCount;
+  }
+
+  // Number of nodes of the tree built by the last search
+  unsigned int getTreeSize() const {
+    return treeSize;
+  }
+
+  /**
+   * @param nbThreads: number of search threads, including the calling thread.
+   * @param playout: playout policy.
+   * @param treeSizeLog: the tree holds at most 2^treeSizeLog nodes of 16 bytes.
+   */
+  explicit MCTSEngine(unsigned int nbThreads = std::thread::hardware_concurrency(), Playout playout = Playout::HEURISTIC, int treeSizeLog = 22);
+  MCTSEngine(const MCTSEngine&) = delete;
+  MCTSEngine& operator=(const MCTSEngine&) = delete;
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
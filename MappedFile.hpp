@@ -0,0 +1,115 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Read-only file mapped in memory, so that it is shared between processes and
+ * only the pages actually read are loaded. Without mmap (Windows), the whole
+ * file is read in memory instead.
+ */
+class MappedFile {
+  void *data;
+  size_t length;
+
+ public:
+  MappedFile() : data{0}, length{0} {}
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+  /**
+   * Map a file, closing any previously mapped one.
+   * @param min_length: files shorter than min_length bytes are rejected.
+   * @return true in case of success.
+   */
+#ifndef _WIN32
+  bool open(const std::string &filename, size_t min_length) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size >= off_t(min_length) && st.st_size > 0) {
+      data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if(data == MAP_FAILED) data = 0;
+      else length = st.st_size;
+    }
+    ::close(fd);
+    return data != 0;
+  }
+
+  void close() {
+    if(data) munmap(data, length);
+    data = 0;
+    length = 0;
+  }
+#else
+  bool open(const std::string &filename, size_t min_length) {
+    close();
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if(ifs.fail() || size_t(ifs.tellg()) < min_length || ifs.tellg() == 0) return false;
+    length = ifs.tellg();
+    char *ptr = new char[length];
+    ifs.seekg(0);
+    ifs.read(ptr, length);
+    if(ifs.fail()) {
+      delete[] ptr;
+      length = 0;
+      return false;
+    }
+    data = ptr;
+    return true;
+  }
+
+  void close() {
+    delete[] static_cast<char*>(data);
+    data = 0;
+    length = 0;
+  }
+#endif
+
+  const void* get() const {
+    return data;
+  }
+
+  size_t size() const {
+    return length;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
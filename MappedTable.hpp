@@ -0,0 +1,147 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPED_TABLE_HPP
+#define MAPPED_TABLE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "MappedFile.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Read-only table associating a 8 bits value to 64 bits keys.
+ *
+ * Keys are stored sorted in a file that is memory mapped, so that a table is
+ * shared between processes and only the pages actually probed are loaded.
+ * Lookup is a binary search, there is no collision and no false positive.
+ *
+ * File format:
+ * - 1 byte: board width
+ * - 1 byte: board height
+ * - 1 byte: table specific parameter (e.g. max number of empty cells)
+ * - 1 byte: key size in bytes (8)
+ * - 1 byte: value size in bytes (1)
+ * - 3 bytes: padding (0)
+ * - 8 bytes: number of stored elements (size)
+ * - size key elements, in increasing order
+ * - size value elements
+ */
+class MappedTable {
+  static constexpr size_t HEADER_SIZE = 16;
+
+  const uint64_t *keys;
+  const uint8_t *values;
+  size_t size;
+  MappedFile file;
+
+  void release() {
+    file.close();
+    keys = 0;
+    values = 0;
+    size = 0;
+  }
+
+ public:
+  MappedTable() : keys{0}, values{0}, size{0} {}
+
+  MappedTable(const MappedTable&) = delete;
+  MappedTable& operator=(const MappedTable&) = delete;
+
+  ~MappedTable() {
+    release();
+  }
+
+  /**
+   * Map a table file in memory.
+   * @param filename: table file.
+   * @param width, height: expected board size.
+   * @param param: set to the table specific parameter byte in case of success.
+   * @return true in case of success, in case of failure the table is empty.
+   */
+  bool load(const std::string &filename, int width, int height, int &param) {
+    release();
+    if(!file.open(filename, HEADER_SIZE)) {
+      std::cerr << "Unable to load table: " << filename << std::endl;
+      return false;
+    }
+    const size_t length = file.size();
+    const uint8_t *header = static_cast<const uint8_t*>(file.get());
+    uint64_t count;
+    memcpy(&count, header + 8, sizeof(count));
+    if(header[0] != width || header[1] != height || header[3] != sizeof(uint64_t) || header[4] != 1
+        || (length - HEADER_SIZE) / (sizeof(uint64_t) + 1) < count) {
+      std::cerr << "Unable to load table: invalid header in " << filename << std::endl;
+      release();
+      return false;
+    }
+    param = header[2];
+    size = count;
+    keys = reinterpret_cast<const uint64_t*>(header + HEADER_SIZE);
+    values = header + HEADER_SIZE + size * sizeof(uint64_t);
+    return true;
+  }
+
+  /**
+   * Write a table file.
+   * @param entries: (key, value) pairs sorted by increasing and unique keys.
+   * @return true in case of success.
+   */
+  static bool save(const std::string &filename, int width, int height, int param,
+                   const std::vector<std::pair<uint64_t, uint8_t>> &entries) {
+    std::ofstream ofs(filename, std::ios::binary);
+    char header[HEADER_SIZE] = {0};
+    header[0] = width;
+    header[1] = height;
+    header[2] = param;
+    header[3] = sizeof(uint64_t);
+    header[4] = 1;
+    uint64_t count = entries.size();
+    memcpy(header + 8, &count, sizeof(count));
+    ofs.write(header, HEADER_SIZE);
+    for(const auto &e : entries) ofs.write(reinterpret_cast<const char *>(&e.first), sizeof(uint64_t));
+    for(const auto &e : entries) ofs.write(reinterpret_cast<const char *>(&e.second), 1);
+    ofs.close();
+    return !ofs.fail();
+  }
+
+  /**
+   * Get the value of a key
+   * @return value associated with the key if present, 0 otherwise.
+   */
+  uint8_t get(uint64_t key) const {
+    const uint64_t *it = std::lower_bound(keys, keys + size, key);
+    if(it != keys + size && *it == key) return values[it - keys];
+    else return 0;
+  }
+
+  size_t getSize() const {
+    return size;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
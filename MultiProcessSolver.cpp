@@ -0,0 +1,153 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "MultiProcessSolver.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+namespace {
+
+// Result of a column sent by a worker process through its pipe
+struct ColumnResult {
+  int col;
+  int score;
+  unsigned long long nodes;
+};
+
+bool writeAll(int fd, const void *buffer, size_t length) {
+  const char *p = static_cast<const char*>(buffer);
+  while(length) {
+    ssize_t n = write(fd, p, length);
+    if(n <= 0) return false;
+    p += n;
+    length -= n;
+  }
+  return true;
+}
+
+bool readAll(int fd, void *buffer, size_t length) {
+  char *p = static_cast<char*>(buffer);
+  while(length) {
+    ssize_t n = read(fd, p, length);
+    if(n <= 0) return false;
+    p += n;
+    length -= n;
+  }
+  return true;
+}
+
+} // namespace
+
+std::vector<int> MultiProcessSolver::analyze(const Position &P, bool weak) {
+  std::vector<int> scores(Position::WIDTH, MultiProcessSolver::INVALID_MOVE);
+  std::vector<bool> solved(Position::WIDTH, true);
+  std::vector<std::vector<int>> columns(nbProcesses); // columns solved by each worker
+  int nbColumns = 0;
+  for(int i = 0; i < Position::WIDTH; i++) { // center columns first, so that the slowest ones are started first
+    int col = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+    if(P.canPlay(col)) {
+      if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+      else {
+        columns[nbColumns++ % nbProcesses].push_back(col);
+        solved[col] = false;
+      }
+    }
+  }
+
+  std::vector<pid_t> pids(nbProcesses, -1);
+  std::vector<int> pipes(nbProcesses, -1);
+  for(unsigned int p = 0; p < nbProcesses && !columns[p].empty(); p++) {
+    int fds[2];
+    if(pipe(fds) != 0) break;
+    pid_t pid = fork();
+    if(pid == 0) { // worker process: solve its columns and report them to the parent
+      close(fds[0]);
+      for(int col : columns[p]) {
+        unsigned long long previousCount = solver->getNodeCount();
+        Position P2(P);
+        P2.playCol(col);
+        ColumnResult result{col, -solver->solve(P2, weak), 0};
+        result.nodes = solver->getNodeCount() - previousCount;
+        if(!writeAll(fds[1], &result, sizeof(result))) break;
+      }
+      _exit(0);
+    }
+    close(fds[1]);
+    if(pid < 0) {
+      close(fds[0]);
+      break;
+    }
+    pids[p] = pid;
+    pipes[p] = fds[0];
+  }
+
+  for(unsigned int p = 0; p < nbProcesses; p++) {
+    if(pids[p] < 0) continue;
+    ColumnResult result;
+    while(readAll(pipes[p], &result, sizeof(result)))
+      if(result.col >= 0 && result.col < Position::WIDTH && !solved[result.col]) {
+        scores[result.col] = result.score;
+        solved[result.col] = true;
+        nodeCount += result.nodes;
+      }
+    close(pipes[p]);
+    int status;
+    waitpid(pids[p], &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      std::cerr << "Solver worker process " << pids[p] << " failed, solving its columns locally" << std::endl;
+  }
+
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(!solved[col]) { // worker crashed or could not be started
+      unsigned long long previousCount = solver->getNodeCount();
+      Position P2(P);
+      P2.playCol(col);
+      scores[col] = -solver->solve(P2, weak);
+      nodeCount += solver->getNodeCount() - previousCount;
+    }
+  return scores;
+}
+
+int MultiProcessSolver::solve(const Position &P, bool weak) {
+  if(P.canWinNext()) // check if win in one move as the search does not support this case.
+    return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  int best = 0; // full board is a draw
+  bool playable = false;
+  for(int score : analyze(P, weak))
+    if(score != INVALID_MOVE && (!playable || score > best)) {
+      best = score;
+      playable = true;
+    }
+  if(weak) best = (best > 0) - (best < 0); // same result as the weak Solver
+  return best;
+}
+
+// Constructor
+MultiProcessSolver::MultiProcessSolver(unsigned int nbProcesses, const std::string &tableName) :
+  nbProcesses{nbProcesses < 1 ? 1 : nbProcesses}, nodeCount{0} {
+  void *storage = memory.open(tableName, ParallelSolver::tableStorageSize()) ? memory.get() : nullptr;
+  if(!storage) std::cerr << "Using a private transposition table" << std::endl;
+  solver.reset(new ParallelSolver(1, storage)); // no helper thread: the solver must survive fork()
+}
+
+} // namespace Connect4
+} // namespace GameSolver
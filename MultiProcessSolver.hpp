@@ -0,0 +1,93 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MULTI_PROCESS_SOLVER_HPP
+#define MULTI_PROCESS_SOLVER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Position.hpp"
+#include "ParallelSolver.hpp"
+#include "SharedMemory.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Solver distributing the root subtrees of a position over forked worker processes.
+ *
+ * All the processes attach the same transposition table placed in named POSIX
+ * shared memory, whose entries are updated lock-free (see AtomicTranspositionTable).
+ * As the table outlives the processes, separate invocations of a program
+ * on the same host reuse each other's search results.
+ *
+ * A worker crash only loses the columns it was solving, they are then solved
+ * by the calling process.
+ */
+class MultiProcessSolver {
+ private:
+  SharedMemory memory;             // shared transposition table storage
+  std::unique_ptr<ParallelSolver> solver; // single threaded solver, inherited by the forked workers
+  unsigned int nbProcesses;
+  unsigned long long nodeCount;    // counter of explored nodes, including the workers
+
+ public:
+  static const int INVALID_MOVE = -1000;
+
+  // default name of the shared transposition table
+  static std::string defaultTableName() {
+    return "/c4solver-" + std::to_string(Position::WIDTH) + "x" + std::to_string(Position::HEIGHT);
+  }
+
+  // Returns the score of a position
+  int solve(const Position &P, bool weak = false);
+
+  // Returns the score off all possible moves of a position as an array, each column being
+  // solved by one of the worker processes. Returns INVALID_MOVE for unplayable columns
+  std::vector<int> analyze(const Position &P, bool weak = false);
+
+  unsigned long long getNodeCount() const {
+    return nodeCount;
+  }
+
+  // Empty the shared transposition table, for all the processes using it
+  void reset() {
+    nodeCount = 0;
+    solver->reset();
+  }
+
+  void loadBook(std::string book_file) {
+    solver->loadBook(book_file);
+  }
+
+  void loadEndgameTable(std::string table_file) {
+    solver->loadEndgameTable(table_file);
+  }
+
+  /**
+   * @param nbProcesses: number of worker processes.
+   * @param tableName: name of the shared memory transposition table, if it cannot
+   *        be opened a private table is used and the workers do not share results.
+   */
+  explicit MultiProcessSolver(unsigned int nbProcesses, const std::string &tableName = defaultTableName());
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -19,8 +19,16 @@
 #ifndef OPENING_BOOK_HPP
 #define OPENING_BOOK_HPP
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "Position.hpp"
 #include "TranspositionTable.hpp"
 
@@ -29,10 +37,30 @@ namespace Connect4 {
 
 class OpeningBook {
   TableGetter<Position::position_t, uint8_t> *T;
+  uint8_t *moves; // optional best move of each entry of T, 1 + column in the orientation of key3(), 0 if unknown
   const int width;
   const int height;
   int depth;
 
+  /**
+   * Deep line section: positions beyond depth, typically the most played ones, identified
+   * by their symmetricKey() as key3() overflows in deep positions, and positions within depth
+   * whose entry of T holds another position (see add). Values are encoded as in T, best moves
+   * as 1 + column in the orientation of the symmetricKey(), 0 if unknown.
+   */
+  struct DeepEntry {
+    uint8_t value;
+    uint8_t move;
+  };
+  std::unordered_map<Position::position_t, DeepEntry> deep;
+  uint64_t deep_depths; // bit n is set if deep holds positions with n moves, to skip probes at other depths
+
+  const DeepEntry* findDeep(const Position &P) const {
+    if(!(deep_depths >> P.nbMoves() & 1)) return 0;
+    auto it = deep.find(P.symmetricKey());
+    return it == deep.end() ? 0 : &it->second;
+  }
+
   template<class partial_key_t>
   TableGetter<Position::position_t, uint8_t>* initTranspositionTable(int log_size) {
     switch(log_size) {
@@ -70,10 +98,69 @@ class OpeningBook {
     }
   }
 
+  // Read the optional deep line section, return false if it is truncated
+  bool loadDeep(std::ifstream &ifs) {
+    uint64_t count;
+    ifs.read(reinterpret_cast<char *>(&count), sizeof(count));
+    if(ifs.gcount() == 0) return true; // no deep section
+    if(ifs.fail()) return false;
+    std::vector<Position::position_t> keys(count);
+    std::vector<uint8_t> values(count), deep_moves(count);
+    ifs.read(reinterpret_cast<char *>(keys.data()), count * sizeof(Position::position_t));
+    ifs.read(reinterpret_cast<char *>(values.data()), count);
+    if(ifs.fail()) return false;
+    ifs.read(reinterpret_cast<char *>(deep_moves.data()), count);
+    if(ifs.gcount() != 0 && ifs.fail()) return false; // the best moves are optional
+    deep.reserve(count);
+    for(uint64_t i = 0; i < count; i++) putDeep(keys[i], values[i], deep_moves[i]);
+    return true;
+  }
+
  public:
-  OpeningBook(int width, int height) : T{0}, width{width}, height{height}, depth{ -1} {} // Empty opening book
+  OpeningBook(int width, int height) : T{0}, moves{0}, width{width}, height{height}, depth{ -1}, deep_depths{0} {} // Empty opening book
+
+  // Take ownership of a table and of its optional best moves, an array of T->getSize() elements allocated with new[]
+  OpeningBook(int width, int height, int depth, TableGetter<Position::position_t, uint8_t>* T, uint8_t *moves = 0) :
+    T{T}, moves{moves}, width{width}, height{height}, depth{depth}, deep_depths{0} {}
 
-  OpeningBook(int width, int height, int depth, TableGetter<Position::position_t, uint8_t>* T) : T{T}, width{width}, height{height}, depth{depth} {} // Empty opening book
+  /**
+   * Empty opening book to be filled with put()
+   * @param depth: max depth of the stored positions.
+   * @param log_size: the book has room for about 2^log_size positions.
+   */
+  OpeningBook(int width, int height, int depth, int log_size) : T{0}, moves{0}, width{width}, height{height}, depth{depth}, deep_depths{0} {
+    static constexpr double LOG_3 = 1.58496250072; // log2(3)
+    const int partial_key_bits = int((depth + width - 1) * LOG_3) + 1 - log_size; // the key3 of the position is this much bigger than the table
+    T = initTranspositionTable(partial_key_bits <= 8 ? 1 : partial_key_bits <= 16 ? 2 : 4, log_size);
+    if(!T || partial_key_bits > 32) {
+      std::cerr << "Unable to create an opening book of depth " << depth << " and size 2^" << log_size << std::endl;
+      delete T;
+      T = 0;
+      this->depth = -1;
+    }
+  }
+
+  OpeningBook(const OpeningBook&) = delete;
+  OpeningBook& operator=(const OpeningBook&) = delete;
+
+  /**
+   * Load an opening book once per process.
+   *
+   * A loaded book is immutable and get() is thread-safe, so all the solvers
+   * asking for the same file share a single copy, which is freed when the last
+   * of them releases it.
+   * @return the shared book, an empty book if the file cannot be loaded.
+   */
+  static std::shared_ptr<const OpeningBook> loadShared(const std::string &filename) {
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<const OpeningBook>> books;
+    std::lock_guard<std::mutex> lock(mutex);
+    if(std::shared_ptr<const OpeningBook> book = books[filename].lock()) return book;
+    std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>(Position::WIDTH, Position::HEIGHT);
+    book->load(filename);
+    if(book->depth >= 0) books[filename] = book; // failures are not kept, a later call will try again
+    return book;
+  }
   /**
     * Opening book file format:
     * - 1 byte: board width
@@ -84,10 +171,22 @@ class OpeningBook {
     * - 1 byte: log_size = log2(size). number of stored elements (size) is smallest prime number above 2^(log_size)
     * - size key elements
     * - size value elements
+    * - optionally size best move elements of 1 byte: 0 if unknown, otherwise 1 + the best column
+    *   to play, as seen from the orientation used by key3() (see Position::isKey3Mirrored)
+    * - optionally, only after the best moves, a deep line section:
+    *   - 8 bytes: number of deep positions (count)
+    *   - count elements of 8 bytes: symmetricKey() of the positions
+    *   - count value elements
+    *   - optionally count best move elements of 1 byte: 0 if unknown, otherwise 1 + the best column
+    *     to play, as seen from the orientation of the symmetricKey()
     */
   void load(std::string filename) {
     depth = -1;
     delete T;
+    delete[] moves;
+    moves = 0;
+    deep.clear();
+    deep_depths = 0;
     std::ifstream ifs(filename, std::ios::binary); // open file
 
     if(ifs.fail()) {
@@ -140,6 +239,18 @@ class OpeningBook {
         std::cerr << "Unable to load data from opening book" << std::endl;
         return;
       }
+      moves = new uint8_t[T->getSize()];
+      ifs.read(reinterpret_cast<char *>(moves), T->getSize());
+      if(ifs.gcount() == 0) { // the best move section is optional
+        delete[] moves;
+        moves = 0;
+      } else if(ifs.fail()) {
+        std::cerr << "Unable to load best moves from opening book" << std::endl;
+        return;
+      } else if(!loadDeep(ifs)) {
+        std::cerr << "Unable to load deep lines from opening book" << std::endl;
+        return;
+      }
       depth = _depth; // set it in case of success only, keep -1 in case of failure
       std::cerr << "done" << std::endl;
     }
@@ -147,8 +258,14 @@ class OpeningBook {
     ifs.close();
   }
 
-  void save(const std::string output_file) const {
-    std::ofstream ofs(output_file, std::ios::binary);
+  /**
+   * Write the book to a temporary file renamed to output_file once complete,
+   * so that a crash never leaves a truncated book and readers see either the old or the new one.
+   * @return true in case of success.
+   */
+  bool save(const std::string output_file) const {
+    const std::string tmp_file = output_file + ".tmp";
+    std::ofstream ofs(tmp_file, std::ios::binary);
     char tmp;
     tmp = width;
     ofs.write(&tmp, 1);
@@ -165,16 +282,145 @@ class OpeningBook {
 
     ofs.write(reinterpret_cast<const char *>(T->getKeys()), T->getSize() * T->getKeySize());
     ofs.write(reinterpret_cast<const char *>(T->getValues()), T->getSize() * T->getValueSize());
+    if(moves) ofs.write(reinterpret_cast<const char *>(moves), T->getSize());
+    else if(!deep.empty()) ofs.write(std::vector<char>(T->getSize(), 0).data(), T->getSize()); // the deep section follows the best moves
+    if(!deep.empty()) {
+      std::vector<std::pair<Position::position_t, DeepEntry>> entries(deep.begin(), deep.end());
+      std::sort(entries.begin(), entries.end(), [](const std::pair<Position::position_t, DeepEntry> &a,
+                                                   const std::pair<Position::position_t, DeepEntry> &b) {return a.first < b.first;}); // deterministic output
+      uint64_t count = entries.size();
+      bool deep_moves = false;
+      ofs.write(reinterpret_cast<const char *>(&count), sizeof(count));
+      for(const auto &e : entries) ofs.write(reinterpret_cast<const char *>(&e.first), sizeof(e.first));
+      for(const auto &e : entries) {
+        ofs.write(reinterpret_cast<const char *>(&e.second.value), 1);
+        deep_moves |= e.second.move != 0;
+      }
+      if(deep_moves) for(const auto &e : entries) ofs.write(reinterpret_cast<const char *>(&e.second.move), 1);
+    }
     ofs.close();
+    if(ofs.fail() || std::rename(tmp_file.c_str(), output_file.c_str()) != 0) {
+      std::cerr << "Unable to save opening book: " << output_file << std::endl;
+      std::remove(tmp_file.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  int getDepth() const {
+    return depth;
+  }
+
+  // Number of entries of the table, a power of 2 rounded up to a prime number
+  size_t getSize() const {
+    return T ? T->getSize() : 0;
+  }
+
+  /**
+   * Store a position given by its key3(), overwriting the entry of any other position
+   * colliding with it.
+   * @param value: score - MIN_SCORE + 1.
+   * @param move: 1 + best column in the orientation of key3, 0 if unknown.
+   */
+  void put(uint64_t key3, uint8_t value, uint8_t move = 0) {
+    T->put(key3, value);
+    if(!moves) {
+      if(!move) return;
+      moves = new uint8_t[T->getSize()](); // best moves are stored once one is known
+    }
+    moves[T->locate(key3)] = move;
+  }
+
+  /**
+   * Store a position within the depth of the book without losing any other position: it goes to
+   * the deep line section if its entry of the table holds another position.
+   * @param value, move: encoded as in put().
+   * @return false if the position was stored in the deep line section.
+   */
+  bool add(uint64_t key3, uint8_t value, uint8_t move = 0) {
+    const size_t pos = key3 % T->getSize(); // entry of key3, as used by forEach()
+    if(!static_cast<const uint8_t*>(T->getValues())[pos] || T->locate(key3) == pos) {
+      put(key3, value, move);
+      return true;
+    }
+    const Position P = Position::fromKey3(key3); // in the orientation of the key3, as move
+    const bool mirrored = P.mirrorKey() < P.key(); // the symmetricKey is the one of the mirror image
+    putDeep(P.symmetricKey(), value, move && mirrored ? width + 1 - move : move);
+    return false;
+  }
+
+  /**
+   * Call f(key3, value, move) for every stored position, with value and move encoded as in put().
+   *
+   * Only the low bits of the keys are stored, the full key3 is rebuilt from them and from the index
+   * of the entry (key3 modulo the prime size) thanks to the Chinese remainder theorem.
+   */
+  template<class F>
+  void forEach(F f) const {
+    if(depth < 0) return;
+    const uint64_t size = T->getSize();
+    const int partial_bits = 8 * T->getKeySize();
+    uint64_t inverse = 1; // inverse of 2^partial_bits modulo the prime size, by Fermat's little theorem
+    for(uint64_t base = (uint64_t(1) << partial_bits) % size, e = size - 2; e; e >>= 1, base = base * base % size)
+      if(e & 1) inverse = inverse * base % size;
+    const uint8_t *values = static_cast<const uint8_t*>(T->getValues());
+    const uint8_t *keys = static_cast<const uint8_t*>(T->getKeys());
+    for(uint64_t pos = 0; pos < size; pos++) {
+      if(!values[pos]) continue; // empty entry
+      uint64_t partial = 0;
+      memcpy(&partial, keys + pos * T->getKeySize(), T->getKeySize()); // little endian, as written by save()
+      const uint64_t k = (pos + size - partial % size) % size * inverse % size;
+      f(partial + (k << partial_bits), values[pos], moves ? moves[pos] : 0);
+    }
   }
 
   int get(const Position &P) const {
-    if(P.nbMoves() > depth) return 0;
-    else return T->get(P.key3());
+    if(P.nbMoves() <= depth)
+      if(int value = T->get(P.key3())) return value;
+    const DeepEntry *e = findDeep(P);
+    return e ? e->value : 0;
+  }
+
+  /**
+   * Store a position in the deep line section.
+   * @param symmetric_key: symmetricKey() of the position.
+   * @param value: score - MIN_SCORE + 1.
+   * @param move: 1 + best column in the orientation of symmetric_key, 0 if unknown.
+   */
+  void putDeep(Position::position_t symmetric_key, uint8_t value, uint8_t move = 0) {
+    deep[symmetric_key] = DeepEntry{value, move};
+    deep_depths |= uint64_t(1) << Position::nbMovesOfKey(symmetric_key);
+  }
+
+  // Call f(symmetric_key, value, move) for every position of the deep line section
+  template<class F>
+  void forEachDeep(F f) const {
+    for(const auto &e : deep) f(e.first, e.second.value, e.second.move);
+  }
+
+  size_t getDeepSize() const {
+    return deep.size();
+  }
+
+  /**
+   * @return the best column to play (0-based) in a position, -1 if the book does not know it.
+   */
+  int getMove(const Position &P) const {
+    if(moves && P.nbMoves() <= depth) {
+      size_t pos = T->locate(P.key3());
+      if(pos != T->getSize() && moves[pos]) {
+        int column = moves[pos] - 1;
+        return P.isKey3Mirrored() ? width - 1 - column : column;
+      }
+    }
+    const DeepEntry *e = findDeep(P);
+    if(!e || !e->move) return -1;
+    return P.mirrorKey() < P.key() ? width - e->move : e->move - 1;
   }
 
   ~OpeningBook() {
     delete T;
+    delete[] moves;
   }
 };
 
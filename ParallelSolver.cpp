@@ -0,0 +1,237 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include "ParallelSolver.hpp"
+#include "MoveSorter.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+int ParallelSolver::search(Worker &w, const Position &P, int alpha, int beta, const SplitPoint *parent) {
+  assert(alpha < beta);
+  assert(!P.canWinNext());
+
+  if((++w.nodeCount & CANCEL_CHECK_PERIOD) == 0 && parent && parent->cancelled()) {
+    w.aborting = true; // unwind without saving anything in the transposition table
+    return 0;
+  }
+
+  Position::position_t possible = P.possibleNonLosingMoves();
+  if(possible == 0)     // if no possible non losing move, opponent wins next move
+    return -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+
+  if(P.nbMoves() >= Position::WIDTH * Position::HEIGHT - 2) // check for draw game
+    return 0;
+
+  int min = -(Position::WIDTH * Position::HEIGHT - 2 - P.nbMoves()) / 2;	// lower bound of score as opponent cannot win next move
+  if(alpha < min) {
+    alpha = min;                     // there is no need to keep alpha below our max possible score.
+    if(alpha >= beta) return alpha;  // prune the exploration if the [alpha;beta] window is empty.
+  }
+
+  int max = (Position::WIDTH * Position::HEIGHT - 1 - P.nbMoves()) / 2;	// upper bound of our score as we cannot win immediately
+  if(beta > max) {
+    beta = max;                     // there is no need to keep beta above our max possible score.
+    if(alpha >= beta) return beta;  // prune the exploration if the [alpha;beta] window is empty.
+  }
+
+  const Position::position_t key = P.key();
+  const int entry = transTable->get(key);
+  // known bounds of the score, they are kept when saving a new bound of the position
+  const int lower = (entry >> 8) ? (entry >> 8) - BOUND_OFFSET : min;
+  const int upper = (entry & 0xff) ? (entry & 0xff) - BOUND_OFFSET : max;
+  if(lower == upper) return lower; // bounds meet: the score is exact
+  if(alpha < lower) {
+    alpha = lower;                   // there is no need to keep alpha below our known lower bound.
+    if(alpha >= beta) return alpha;  // prune the exploration if the [alpha;beta] window is empty.
+  }
+  if(beta > upper) {
+    beta = upper;                    // there is no need to keep beta above our known upper bound.
+    if(alpha >= beta) return beta;   // prune the exploration if the [alpha;beta] window is empty.
+  }
+
+  if(int val = book->get(P)) return val + Position::MIN_SCORE - 1; // look for solutions stored in opening book
+  if(int val = endgame.get(P)) return val + Position::MIN_SCORE - 1; // look for solutions stored in endgame table
+
+  possible = P.removeMirroredMoves(possible); // mirrored moves of a symmetric position have the same score
+  MoveSorter moves;
+  for(int i = Position::WIDTH; i--;)
+    if(Position::position_t move = possible & Position::column_mask(columnOrder[i]))
+      moves.add(move, P.moveScore(move));
+
+  // young brothers are only searched in parallel far enough from the leaves
+  const bool split = workers.size() > 1 && Position::WIDTH * Position::HEIGHT - P.nbMoves() > SERIAL_EMPTY_CELLS;
+  Position::position_t next = moves.getNext();
+  do {
+    Position P2(P);
+    P2.play(next);  // It's opponent turn in P2 position after current player plays x column.
+    int score = -search(w, P2, -beta, -alpha, parent);
+    if(w.aborting) return 0;
+
+    if(score >= beta) {
+      transTable->put(key, encodeBounds(score, upper)); // save the lower bound of the position
+      return score;  // prune the exploration if we find a possible move better than what we were looking for.
+    }
+    if(score > alpha) alpha = score;
+    next = moves.getNext();
+  } while(next && !split);
+
+  if(next) { // the eldest brother did not produce a cutoff, search the young brothers in parallel
+    SplitPoint sp(parent, P, alpha, beta);
+    int nbTasks = 0;
+    for(; next; next = moves.getNext()) sp.tasks[nbTasks++] = Task{&sp, next};
+    sp.pending.store(nbTasks, std::memory_order_relaxed);
+    for(int i = nbTasks; i--;) // best ordered moves are popped first
+      if(!w.tasks.push(&sp.tasks[i])) execute(w, sp.tasks[i]); // no room left in the deque, search it right away
+
+    while(sp.pending.load(std::memory_order_acquire)) { // help until all the young brothers are searched
+      Task *task = w.tasks.pop();
+      if(!task) task = steal(w);
+      if(task) execute(w, *task);
+      else std::this_thread::yield();
+    }
+    if(parent && parent->cancelled()) {
+      w.aborting = true;
+      return 0;
+    }
+    int score = sp.alpha.load(std::memory_order_relaxed);
+    if(score >= beta) {
+      transTable->put(key, encodeBounds(score, upper)); // save the lower bound of the position
+      return score;
+    }
+    alpha = score;
+  }
+
+  transTable->put(key, encodeBounds(lower, alpha)); // save the upper bound of the position
+  return alpha;
+}
+
+void ParallelSolver::execute(Worker &w, Task &task) {
+  SplitPoint &sp = *task.sp;
+  int alpha = sp.alpha.load(std::memory_order_relaxed);
+  if(!sp.cancelled() && alpha < sp.beta) {
+    Position P2(sp.P);
+    P2.play(task.move);
+    int score = -search(w, P2, -sp.beta, -alpha, &sp);
+    if(w.aborting) w.aborting = false; // only this task is cancelled
+    else if(score > alpha) {
+      while(score > alpha && !sp.alpha.compare_exchange_weak(alpha, score, std::memory_order_relaxed));
+      if(score >= sp.beta) sp.cutoff.store(true, std::memory_order_relaxed); // cancel the other young brothers
+    }
+  }
+  sp.pending.fetch_sub(1, std::memory_order_release); // last access to the split point
+}
+
+ParallelSolver::Task* ParallelSolver::steal(Worker &w) {
+  for(size_t i = 1; i < workers.size(); i++) { // round robin over the other workers
+    w.victim = (w.victim + 1) % workers.size();
+    if(workers[w.victim].get() == &w) continue;
+    if(Task *task = workers[w.victim]->tasks.steal()) return task;
+  }
+  return nullptr;
+}
+
+void ParallelSolver::helperLoop(unsigned int index) {
+  Worker &w = *workers[index];
+  while(true) {
+    if(!searching.load(std::memory_order_acquire)) {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeUp.wait(lock, [this] {return quit || searching.load(std::memory_order_acquire);});
+      if(quit) return;
+    }
+    if(Task *task = steal(w)) execute(w, *task);
+    else std::this_thread::yield();
+  }
+}
+
+int ParallelSolver::rootSearch(const Position &P, int alpha, int beta) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    searching.store(true, std::memory_order_release);
+  }
+  wakeUp.notify_all();
+  int score = search(*workers[0], P, alpha, beta, nullptr);
+  searching.store(false, std::memory_order_release);
+  return score;
+}
+
+int ParallelSolver::solve(const Position &P, bool weak) {
+  if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
+    return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  int min = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+  int max = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  if(weak) {
+    min = -1;
+    max = 1;
+  }
+
+  while(min < max) {                    // iteratively narrow the min-max exploration window
+    int med = min + (max - min) / 2;
+    if(med <= 0 && min / 2 < med) med = min / 2;
+    else if(med >= 0 && max / 2 > med) med = max / 2;
+    int r = rootSearch(P, med, med + 1); // use a null depth window to know if the actual score is greater or smaller than med
+    if(r <= med) max = r;
+    else min = r;
+  }
+
+  unsigned long long count = 0;
+  for(auto &w : workers) count += w->nodeCount;
+  nodeCount = count;
+  return min;
+}
+
+std::vector<int> ParallelSolver::analyze(const Position &P, bool weak) {
+  std::vector<int> scores(Position::WIDTH, ParallelSolver::INVALID_MOVE);
+  for (int col = 0; col < Position::WIDTH; col++)
+    if (P.canPlay(col)) {
+      if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+      else {
+        Position P2(P);
+        P2.playCol(col);
+        scores[col] = -solve(P2, weak);
+      }
+    }
+  return scores;
+}
+
+// Constructor
+ParallelSolver::ParallelSolver(unsigned int nbThreads, void *tableStorage) :
+  transTable{tableStorage ? new Table(tableStorage) : new Table()},
+  book{std::make_shared<OpeningBook>(Position::WIDTH, Position::HEIGHT)}, nodeCount{0}, searching{false}, quit{false} {
+  for(int i = 0; i < Position::WIDTH; i++) // initialize the column exploration order, starting with center columns
+    columnOrder[i] = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+  if(nbThreads < 1) nbThreads = 1;
+  for(unsigned int i = 0; i < nbThreads; i++) {
+    workers.emplace_back(new Worker());
+    workers.back()->victim = i;
+  }
+  for(unsigned int i = 1; i < nbThreads; i++) helpers.emplace_back(&ParallelSolver::helperLoop, this, i);
+}
+
+ParallelSolver::~ParallelSolver() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  wakeUp.notify_all();
+  for(auto &t : helpers) t.join();
+}
+
+} // namespace Connect4
+} // namespace GameSolver
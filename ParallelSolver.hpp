@@ -0,0 +1,179 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARALLEL_SOLVER_HPP
+#define PARALLEL_SOLVER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Position.hpp"
+#include "TranspositionTable.hpp"
+#include "OpeningBook.hpp"
+#include "EndgameTable.hpp"
+#include "WorkStealingDeque.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Multi-threaded solver splitting the search tree with the
+ * Young Brothers Wait Concept (YBWC).
+ *
+ * At each node close enough to the root, the first (best ordered) child is
+ * searched serially. Once it failed to produce a beta cutoff, the remaining
+ * children (the young brothers) are pushed as tasks on the work-stealing deque
+ * of the current worker, where idle workers steal them. The worker owning a
+ * split point helps executing tasks until all its young brothers are searched.
+ * A beta cutoff at a split point cancels all the searches still running below it.
+ *
+ * All the workers share a lock-free transposition table storing both bounds
+ * of the score, with the same encoding as Solver.
+ */
+class ParallelSolver {
+ private:
+  static constexpr int TABLE_SIZE = 24; // store 2^TABLE_SIZE elements in the transpositiontbale
+  static constexpr int SERIAL_EMPTY_CELLS = 20; // positions with less empty cells are searched serially
+  static constexpr unsigned CANCEL_CHECK_PERIOD = 1023; // check for cancellation every 1024 nodes
+  static constexpr int BOUND_OFFSET = Position::WIDTH * Position::HEIGHT / 2 + 1; // see Solver
+
+  struct SplitPoint;
+
+  // Search of a young brother, executed by any worker
+  struct Task {
+    SplitPoint *sp;
+    Position::position_t move;
+  };
+
+  // A node whose young brothers are searched in parallel
+  struct SplitPoint {
+    const SplitPoint *parent;  // enclosing split point, nullptr for the root
+    const Position P;
+    std::atomic<int> alpha;    // best score so far
+    const int beta;
+    std::atomic<bool> cutoff;  // a young brother produced a beta cutoff
+    std::atomic<int> pending;  // number of tasks not completed yet
+    Task tasks[Position::WIDTH];
+
+    SplitPoint(const SplitPoint *parent, const Position &P, int alpha, int beta) :
+      parent{parent}, P(P), alpha{alpha}, beta{beta}, cutoff{false}, pending{0} {}
+
+    // @return true if the result of this split point is no longer needed
+    bool cancelled() const {
+      for(const SplitPoint *sp = this; sp; sp = sp->parent)
+        if(sp->cutoff.load(std::memory_order_relaxed)) return true;
+      return false;
+    }
+  };
+
+  struct alignas(64) Worker {
+    WorkStealingDeque<Task, 10> tasks;
+    unsigned long long nodeCount = 0;
+    bool aborting = false;      // the current task is cancelled and unwinding
+    unsigned int victim = 0;    // next worker to steal from
+  };
+
+  using Table = AtomicTranspositionTable<Position::position_t, TABLE_SIZE>;
+  std::unique_ptr<Table> transTable;
+  std::shared_ptr<const OpeningBook> book; // opening book, possibly shared with other solvers
+  EndgameTable endgame; // endgame tablebase
+  int columnOrder[Position::WIDTH]; // column exploration order
+  unsigned long long nodeCount; // counter of explored nodes of previous searches
+
+  std::vector<std::unique_ptr<Worker>> workers; // worker 0 is the thread calling solve
+  std::vector<std::thread> helpers;
+  std::atomic<bool> searching;
+  bool quit;
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+
+  static uint16_t encodeBounds(int lower, int upper) {
+    return (lower + BOUND_OFFSET) << 8 | (upper + BOUND_OFFSET);
+  }
+
+  /**
+   * Same contract as Solver::negamax. Positions with enough empty cells become
+   * split points once their first child is searched.
+   * @param parent: innermost enclosing split point, the search is stopped
+   *        and returns a meaningless value if it gets cancelled.
+   */
+  int search(Worker &w, const Position &P, int alpha, int beta, const SplitPoint *parent);
+
+  void execute(Worker &w, Task &task);
+  Task* steal(Worker &w);
+  void helperLoop(unsigned int index);
+
+  // run a root null window search on the calling thread with the help of all the workers
+  int rootSearch(const Position &P, int alpha, int beta);
+
+ public:
+  static const int INVALID_MOVE = -1000;
+
+  // Returns the score of a position
+  int solve(const Position &P, bool weak = false);
+
+  // Returns the score off all possible moves of a position as an array.
+  // Returns INVALID_MOVE for unplayable columns
+  std::vector<int> analyze(const Position &P, bool weak = false);
+
+  unsigned long long getNodeCount() const {
+    return nodeCount;
+  }
+
+  void reset() {
+    nodeCount = 0;
+    for(auto &w : workers) w->nodeCount = 0;
+    transTable->reset();
+  }
+
+  void loadBook(std::string book_file) {
+    book = OpeningBook::loadShared(book_file);
+  }
+
+  // Use an already loaded opening book
+  void setBook(std::shared_ptr<const OpeningBook> shared_book) {
+    book = std::move(shared_book);
+  }
+
+  void loadEndgameTable(std::string table_file) {
+    endgame.load(table_file);
+  }
+
+  // Size in bytes of an external storage for the transposition table
+  static constexpr size_t tableStorageSize() {
+    return Table::storageSize();
+  }
+
+  /**
+   * @param nbThreads: number of search threads, including the calling thread.
+   * @param tableStorage: optional external storage of tableStorageSize() bytes for the
+   *        transposition table (e.g. shared memory), it must outlive the solver.
+   */
+  explicit ParallelSolver(unsigned int nbThreads = std::thread::hardware_concurrency(), void *tableStorage = nullptr);
+  ~ParallelSolver();
+  ParallelSolver(const ParallelSolver&) = delete;
+  ParallelSolver& operator=(const ParallelSolver&) = delete;
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
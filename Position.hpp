@@ -145,6 +145,14 @@ class Position {
     return seq.size();
   }
 
+  /**
+   * Bitmap of the next possible valid moves for the current player
+   * Including losing moves.
+   */
+  position_t possible() const {
+    return (mask + bottom_mask) & board_mask;
+  }
+
   /**
    * return true if current player can win next move
    */
@@ -167,6 +175,36 @@ class Position {
     return current_position + mask;
   }
 
+  /**
+   * @return the number of moves of the position of a key(), mirrorKey() or symmetricKey().
+   * A column holding h stones has a key between 2^h - 1 (mask only) and 2^(h+1) - 2.
+   */
+  static int nbMovesOfKey(position_t key) {
+    int moves = 0;
+    for(int i = 0; i < Position::WIDTH; i++) {
+      position_t column = ((key >> i * (Position::HEIGHT + 1)) & column_key_mask) + 1;
+      while(column >>= 1) moves++;
+    }
+    return moves;
+  }
+
+  /**
+   * Rebuild a position from its key(), or its mirror image from its mirrorKey().
+   * The key of a column holding h stones is 2^h - 1 (the mask) plus the stones of the current player.
+   */
+  static Position fromKey(position_t key) {
+    Position P;
+    for(int i = 0; i < Position::WIDTH; i++) {
+      const position_t column = (key >> i * (Position::HEIGHT + 1)) & column_key_mask;
+      position_t stones = 0;
+      while(stones + 1 <= column - stones) stones = stones << 1 | 1; // stones = 2^h - 1
+      P.mask |= stones << i * (Position::HEIGHT + 1);
+      P.current_position |= (column - stones) << i * (Position::HEIGHT + 1);
+    }
+    P.moves = nbMovesOfKey(key);
+    return P;
+  }
+
   /**
   * Build a symetric base 3 key. Two symetric positions will have the same key.
   *
@@ -191,6 +229,92 @@ class Position {
     return key_forward < key_reverse ? key_forward / 3 : key_reverse / 3; // take the smallest key and divide per 3 as the last base3 digit is always 0
   }
 
+  /**
+   * Rebuild a position from its key3(), in the orientation used by the key: the mirror image
+   * of the position if isKey3Mirrored(). The digits of key3() are, column after column and from
+   * bottom to top, 1 for a stone of the current player and 2 for the opponent, followed by a 0.
+   */
+  static Position fromKey3(uint64_t key3) {
+    Position P;
+    key3 *= 3; // the last 0 is not part of the key
+    for(int i = Position::WIDTH; i--;) {
+      key3 /= 3; // end of column i
+      int h = 0;
+      uint64_t digits = key3; // count the stones of column i first, they are read from top to bottom
+      while(digits % 3) {
+        digits /= 3;
+        h++;
+      }
+      for(int row = h; row--;) {
+        const position_t cell = position_t(1) << (i * (Position::HEIGHT + 1) + row);
+        P.mask |= cell;
+        if(key3 % 3 == 1) P.current_position |= cell;
+        key3 /= 3;
+      }
+      P.moves += h;
+    }
+    return P;
+  }
+
+  /**
+   * @return true if key3() is built iterating columns from right to left, that is from the
+   * mirror image of the position. Data attached to a key3 and depending on the orientation,
+   * such as a column, is then stored for the mirror image.
+   */
+  bool isKey3Mirrored() const {
+    uint64_t key_forward = 0;
+    for(int i = 0; i < Position::WIDTH; i++) partialKey3(key_forward, i);
+
+    uint64_t key_reverse = 0;
+    for(int i = Position::WIDTH; i--;) partialKey3(key_reverse, i);
+
+    return key_reverse < key_forward;
+  }
+
+  /**
+   * @return the key of the left-right mirror image of the position.
+   */
+  position_t mirrorKey() const {
+    const position_t k = key();
+    position_t m = 0;
+    for(int i = 0; i < Position::WIDTH; i++) {
+      const position_t column = (k >> i * (Position::HEIGHT + 1)) & column_key_mask;
+      m |= column << (Position::WIDTH - 1 - i) * (Position::HEIGHT + 1);
+    }
+    return m;
+  }
+
+  /**
+   * @return true if the position is its own left-right mirror image, as the empty board.
+   * Mirrored moves of such a position lead to mirrored positions having the same score.
+   */
+  bool isSymmetric() const {
+    const position_t k = key();
+    for(int i = 0; i < Position::WIDTH / 2; i++) // most positions differ on the outer columns already
+      if(((k >> i * (Position::HEIGHT + 1)) ^ (k >> (Position::WIDTH - 1 - i) * (Position::HEIGHT + 1))) & column_key_mask) return false;
+    return true;
+  }
+
+  /**
+   * Remove from a bitmap of moves the mirror images of other moves when the position is symmetric:
+   * only the moves in the left half of the board and in the center column are kept.
+   */
+  position_t removeMirroredMoves(position_t moves) const {
+    return isSymmetric() ? moves & left_half_mask : moves;
+  }
+
+  /**
+   * Build a symetric key on WIDTH*(HEIGHT+1) bits. Two symetric positions will have the same key.
+   *
+   * Unlike key3(), this key never overflows, even for positions close to the end of the game.
+   * It is the minimum of the key of the position and the key of its mirror image.
+   */
+  position_t symmetricKey() const {
+    const position_t k = key();
+    const position_t m = mirrorKey();
+    return k < m ? k : m;
+  }
+
   /**
    * Return a bitmap of all the possible next moves the do not lose in one turn.
    * A losing move is a move leaving the possibility for the opponent to win directly.
@@ -282,7 +406,7 @@ class Position {
     * Compute a partial base 3 key for a given column
     */
   void partialKey3(uint64_t &key, int col) const {
-    for(position_t pos = UINT64_C(1) << (col * (Position::HEIGHT + 1)); pos & mask; pos <<= 1) {
+    for(position_t pos = position_t(1) << (col * (Position::HEIGHT + 1)); pos & mask; pos <<= 1) {
       key *= 3;
       if(pos & current_position) key += 1;
       else key += 2;
@@ -304,14 +428,6 @@ class Position {
     return compute_winning_position(current_position ^ mask, mask);
   }
 
-  /**
-   * Bitmap of the next possible valid moves for the current player
-   * Including losing moves.
-   */
-  position_t possible() const {
-    return (mask + bottom_mask) & board_mask;
-  }
-
   /**
    * counts number of bit set to one in a 64bits integer
    */
@@ -364,21 +480,23 @@ class Position {
 
   static constexpr position_t bottom_mask = bottom<WIDTH, HEIGHT>::mask;
   static constexpr position_t board_mask = bottom_mask * ((1LL << HEIGHT) - 1);
+  static constexpr position_t column_key_mask = (position_t(1) << (HEIGHT + 1)) - 1; // HEIGHT+1 bits of a column in key()
+  static constexpr position_t left_half_mask = board_mask & ((position_t(1) << (WIDTH + 1) / 2 * (HEIGHT + 1)) - 1); // columns 0 to WIDTH/2
 
   // return a bitmask containg a single 1 corresponding to the top cel of a given column
   static constexpr position_t top_mask_col(int col) {
-    return UINT64_C(1) << ((HEIGHT - 1) + col * (HEIGHT + 1));
+    return position_t(1) << ((HEIGHT - 1) + col * (HEIGHT + 1));
   }
 
   // return a bitmask containg a single 1 corresponding to the bottom cell of a given column
   static constexpr position_t bottom_mask_col(int col) {
-    return UINT64_C(1) << col * (HEIGHT + 1);
+    return position_t(1) << col * (HEIGHT + 1);
   }
 
  public:
   // return a bitmask 1 on all the cells of a given column
   static constexpr position_t column_mask(int col) {
-    return ((UINT64_C(1) << HEIGHT) - 1) << col * (HEIGHT + 1);
+    return ((position_t(1) << HEIGHT) - 1) << col * (HEIGHT + 1);
   }
 };
 
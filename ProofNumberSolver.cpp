@@ -0,0 +1,117 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ProofNumberSolver.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+bool ProofNumberSolver::evaluate(const Position &P, int target, uint32_t &pn, uint32_t &dn) {
+  bool proven;
+  if(P.canWinNext()) proven = true;                                           // score > 0 >= target
+  else if(P.possibleNonLosingMoves() == 0) proven = false;                    // score < 0 <= target
+  else if(P.nbMoves() >= Position::WIDTH * Position::HEIGHT - 2) proven = target <= 0; // draw game
+  else return false;
+  pn = proven ? 0 : INF;
+  dn = proven ? INF : 0;
+  return true;
+}
+
+void ProofNumberSolver::mid(const Position &P, int target, uint32_t th_pn, uint32_t th_dn) {
+  nodeCount++; // increment counter of explored nodes
+
+  const Position::position_t key = tableKey(P, target);
+  uint32_t pn, dn;
+  if(evaluate(P, target, pn, dn)) {
+    store(key, pn, dn);
+    return;
+  }
+
+  Position children[Position::WIDTH];
+  Position::position_t child_keys[Position::WIDTH];
+  int nb_children = 0;
+  const Position::position_t possible = P.removeMirroredMoves(P.possibleNonLosingMoves()); // mirrored children have the same value
+  for(int i = 0; i < Position::WIDTH; i++)
+    if(Position::position_t move = possible & Position::column_mask(columnOrder[i])) {
+      children[nb_children] = P;
+      children[nb_children].play(move);
+      child_keys[nb_children] = tableKey(children[nb_children], 1 - target);
+      nb_children++;
+    }
+
+  while(true) {
+    int best = 0;           // child with the smallest disproof number
+    uint32_t best_pn = 0;   // proof number of the best child
+    uint32_t second_dn = INF; // second smallest disproof number
+    uint64_t sum_pn = 0;
+    bool disproven_child = false; // a disproven child is a proof for the current position
+    pn = INF;
+    for(int i = 0; i < nb_children; i++) {
+      uint32_t child_pn, child_dn;
+      lookup(child_keys[i], child_pn, child_dn);
+      if(child_dn < pn) {
+        second_dn = pn;
+        pn = child_dn;
+        best = i;
+        best_pn = child_pn;
+      } else if(child_dn < second_dn) second_dn = child_dn;
+      sum_pn += child_pn;
+      if(child_pn >= INF) disproven_child = true;
+    }
+    dn = disproven_child ? INF : sum_pn < INF ? sum_pn : INF - 1;
+    if(pn >= th_pn || dn >= th_dn) break;
+
+    // the best child is explored until it is no longer the most promising one
+    // or until the thresholds of the current position are reached.
+    uint64_t child_th_pn = uint64_t(th_dn) - dn + best_pn;
+    uint32_t child_th_dn = second_dn + 1 < th_pn ? second_dn + 1 : th_pn;
+    mid(children[best], 1 - target, child_th_pn < INF ? child_th_pn : INF, child_th_dn);
+  }
+  store(key, pn, dn);
+}
+
+bool ProofNumberSolver::prove(const Position &P, int target) {
+  const Position::position_t key = tableKey(P, target);
+  uint32_t pn, dn;
+  lookup(key, pn, dn);
+  while(pn != 0 && dn != 0) { // a root search can stop early if its entry is overwritten
+    mid(P, target, INF, INF);
+    lookup(key, pn, dn);
+  }
+  return pn == 0;
+}
+
+int ProofNumberSolver::solve(const Position &P) {
+  if(P.canWinNext()) // check if win in one move as the search does not support this case.
+    return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  if(prove(P, 1)) return 1;
+  return prove(P, 0) ? 0 : -1;
+}
+
+ProofNumberSolver::ProofNumberSolver() : T{new Entry[size]}, nodeCount{0} {
+  reset();
+  for(int i = 0; i < Position::WIDTH; i++) // initialize the column exploration order, starting with center columns
+    columnOrder[i] = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+}
+
+ProofNumberSolver::~ProofNumberSolver() {
+  delete[] T;
+}
+
+} // namespace Connect4
+} // namespace GameSolver
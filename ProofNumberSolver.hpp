@@ -0,0 +1,127 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROOF_NUMBER_SOLVER_HPP
+#define PROOF_NUMBER_SOLVER_HPP
+
+#include <cstdint>
+#include "Position.hpp"
+#include "TranspositionTable.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Weak solver based on depth-first proof-number search (df-pn).
+ *
+ * A position is classified as a win, a draw or a loss by two boolean searches:
+ * does the current player score at least 1 (win), and if not, does it score at
+ * least 0 (draw). Each search proves or disproves that the player to move
+ * reaches a target score, in negamax form: the target of a child is
+ * 1 - target of its parent, the proof number of a node is the minimum
+ * disproof number of its children and its disproof number the sum of the
+ * proof numbers of its children.
+ *
+ * Proof and disproof numbers are stored in a fixed size table where collisions
+ * overwrite the previous entry, this bounds memory and only costs re-searches.
+ */
+class ProofNumberSolver {
+ private:
+  static constexpr int TABLE_SIZE = 21; // store 2^TABLE_SIZE entries in the proof number table
+  static constexpr uint32_t INF = 1 << 30; // infinite proof or disproof number
+
+  static_assert(Position::WIDTH * (Position::HEIGHT + 1) < sizeof(Position::position_t) * 8, "Board does not leave a spare bit for the target in table keys");
+
+  struct Entry {
+    Position::position_t key; // table key of the position, 0 for empty entries
+    uint32_t pn;              // proof number
+    uint32_t dn;              // disproof number
+  };
+
+  static const size_t size = next_prime(1 << TABLE_SIZE);
+  Entry *T;
+  unsigned long long nodeCount; // counter of explored nodes.
+  int columnOrder[Position::WIDTH]; // column exploration order
+
+  /**
+   * Depth-first proof number search of a position.
+   * Stops as soon as the proof number of the position reaches th_pn or its
+   * disproof number reaches th_dn, the numbers are then stored in the table.
+   *
+   * @param target: score the current player should reach, either 0 or 1.
+   */
+  void mid(const Position &P, int target, uint32_t th_pn, uint32_t th_dn);
+
+  /**
+   * Evaluate positions that do not need any search.
+   * @return true if the position is terminal and set pn and dn accordingly.
+   */
+  static bool evaluate(const Position &P, int target, uint32_t &pn, uint32_t &dn);
+
+  /**
+   * Build a non null table key from the position key and the target,
+   * so that results for both targets can be stored and reused across searches.
+   */
+  static Position::position_t tableKey(const Position &P, int target) {
+    return (P.key() << 1 | target) + 1;
+  }
+
+  void lookup(const Position::position_t key, uint32_t &pn, uint32_t &dn) const {
+    const Entry &e = T[key % size];
+    if(e.key == key) {
+      pn = e.pn;
+      dn = e.dn;
+    } else pn = dn = 1;
+  }
+
+  void store(const Position::position_t key, uint32_t pn, uint32_t dn) {
+    Entry &e = T[key % size];
+    e.key = key;
+    e.pn = pn;
+    e.dn = dn;
+  }
+
+  // @return true if the current player of P scores at least target.
+  bool prove(const Position &P, int target);
+
+ public:
+  /**
+   * Weakly solve a position, same semantic as Solver::solve(P, true):
+   * @return the exact score if the current player can win next move,
+   *         otherwise 1 for a win, 0 for a draw and -1 for a loss.
+   */
+  int solve(const Position &P);
+
+  unsigned long long getNodeCount() const {
+    return nodeCount;
+  }
+
+  void reset() {
+    nodeCount = 0;
+    for(size_t i = 0; i < size; i++) T[i] = Entry{0, 0, 0};
+  }
+
+  ProofNumberSolver();
+  ~ProofNumberSolver();
+  ProofNumberSolver(const ProofNumberSolver&) = delete;
+  ProofNumberSolver& operator=(const ProofNumberSolver&) = delete;
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,195 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Position.hpp"
+#include "Solver.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Bounded thread-safe cache of final solve() and analyze() results.
+ *
+ * Positions are identified by Position::symmetricKey() so that a position and
+ * its mirror image share the same entry. Analysis vectors are stored in the
+ * orientation of the smallest key and their columns are reversed when the
+ * queried position is the mirrored one.
+ *
+ * The cache is split in independently locked shards, each one evicting its
+ * entries with the CLOCK algorithm (second chance approximation of LRU).
+ */
+class ResultCache {
+ private:
+  static constexpr int NB_SHARDS = 16;
+  static constexpr int KIND_SHIFT = 56; // the result kind is stored above the WIDTH*(HEIGHT+1) bits of the key
+  static_assert(Position::WIDTH * (Position::HEIGHT + 1) <= KIND_SHIFT, "Board does not fit in the cache key");
+  static constexpr int8_t INVALID = INT8_MIN; // encoding of Solver::INVALID_MOVE
+
+  enum Kind : uint64_t {SOLVE = 0, SOLVE_WEAK = 1, ANALYZE = 2, ANALYZE_WEAK = 3};
+
+  struct Entry {
+    uint64_t key;
+    int8_t scores[Position::WIDTH]; // a single score for solve() results
+    bool referenced;                // second chance bit of the CLOCK algorithm
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::vector<Entry> entries;
+    std::unordered_map<uint64_t, size_t> index; // key -> position in entries
+    size_t hand = 0; // CLOCK hand, next eviction candidate
+  };
+
+  Shard shards[NB_SHARDS];
+  size_t shardCapacity;
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+
+  static uint64_t cacheKey(const Position &P, Kind kind) {
+    return P.symmetricKey() | kind << KIND_SHIFT;
+  }
+
+  // the position is the mirror image of the one defining the orientation of the stored analysis
+  static bool mirrored(const Position &P) {
+    return P.key() != P.symmetricKey();
+  }
+
+  Shard& shard(uint64_t key) {
+    return shards[(key * 0x9E3779B97F4A7C15ULL) >> 60]; // fibonacci hashing on the 4 top bits
+  }
+
+  bool lookup(uint64_t key, int8_t *scores, int n) {
+    Shard &s = shard(key);
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      auto it = s.index.find(key);
+      if(it != s.index.end()) {
+        Entry &e = s.entries[it->second];
+        e.referenced = true;
+        for(int i = 0; i < n; i++) scores[i] = e.scores[i];
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  void store(uint64_t key, const int8_t *scores, int n) {
+    Shard &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.index.find(key);
+    size_t slot;
+    if(it != s.index.end()) slot = it->second;
+    else if(s.entries.size() < shardCapacity) {
+      slot = s.entries.size();
+      s.entries.push_back(Entry());
+      s.index[key] = slot;
+    } else {
+      while(s.entries[s.hand].referenced) { // give a second chance to recently used entries
+        s.entries[s.hand].referenced = false;
+        s.hand = (s.hand + 1) % s.entries.size();
+      }
+      slot = s.hand;
+      s.hand = (s.hand + 1) % s.entries.size();
+      s.index.erase(s.entries[slot].key);
+      s.index[key] = slot;
+    }
+    Entry &e = s.entries[slot];
+    e.key = key;
+    for(int i = 0; i < n; i++) e.scores[i] = scores[i];
+    e.referenced = false;
+  }
+
+ public:
+  /**
+   * @param capacity: maximum number of cached results.
+   */
+  explicit ResultCache(size_t capacity) :
+    shardCapacity{capacity / NB_SHARDS ? capacity / NB_SHARDS : 1}, hits{0}, misses{0} {}
+
+  /**
+   * Look for the score of a position.
+   * @param weak: look for a weak or a strong solve result.
+   * @return true if the score was found and stored in score.
+   */
+  bool getScore(const Position &P, bool weak, int &score) {
+    int8_t value;
+    if(!lookup(cacheKey(P, weak ? SOLVE_WEAK : SOLVE), &value, 1)) return false;
+    score = value;
+    return true;
+  }
+
+  void putScore(const Position &P, bool weak, int score) {
+    int8_t value = score;
+    store(cacheKey(P, weak ? SOLVE_WEAK : SOLVE), &value, 1);
+  }
+
+  /**
+   * Look for the analysis of a position.
+   * @param weak: look for a weak or a strong analyze result.
+   * @return true if the analysis was found and stored in scores (Solver::INVALID_MOVE for unplayable columns).
+   */
+  bool getAnalysis(const Position &P, bool weak, std::vector<int> &scores) {
+    int8_t values[Position::WIDTH];
+    if(!lookup(cacheKey(P, weak ? ANALYZE_WEAK : ANALYZE), values, Position::WIDTH)) return false;
+    const bool mirror = mirrored(P);
+    scores.resize(Position::WIDTH);
+    for(int col = 0; col < Position::WIDTH; col++) {
+      int8_t value = values[mirror ? Position::WIDTH - 1 - col : col];
+      scores[col] = value == INVALID ? Solver::INVALID_MOVE : value;
+    }
+    return true;
+  }
+
+  void putAnalysis(const Position &P, bool weak, const std::vector<int> &scores) {
+    int8_t values[Position::WIDTH];
+    const bool mirror = mirrored(P);
+    for(int col = 0; col < Position::WIDTH; col++) {
+      int score = scores[mirror ? Position::WIDTH - 1 - col : col];
+      values[col] = score == Solver::INVALID_MOVE ? INVALID : score;
+    }
+    store(cacheKey(P, weak ? ANALYZE_WEAK : ANALYZE), values, Position::WIDTH);
+  }
+
+  uint64_t getHits() const {
+    return hits.load(std::memory_order_relaxed);
+  }
+
+  uint64_t getMisses() const {
+    return misses.load(std::memory_order_relaxed);
+  }
+
+  // @return the ratio of lookups that found a result, 0 before any lookup.
+  double hitRate() const {
+    const uint64_t h = getHits(), total = h + getMisses();
+    return total ? double(h) / total : 0;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
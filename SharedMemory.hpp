@@ -0,0 +1,100 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SHARED_MEMORY_HPP
+#define SHARED_MEMORY_HPP
+
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Named POSIX shared memory segment (shm_open + mmap).
+ *
+ * The segment is created zero filled by the first process opening it and
+ * attached by the next ones, including unrelated processes using the same name.
+ * It survives the processes until remove() is called (or the host reboots).
+ */
+class SharedMemory {
+  void *data;
+  size_t size;
+
+ public:
+  SharedMemory() : data{0}, size{0} {}
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  ~SharedMemory() {
+    close();
+  }
+
+  /**
+   * Create or attach a segment.
+   * @param name: segment name, starting with '/'.
+   * @param length: size in bytes, an existing segment must have exactly this size.
+   * @return true in case of success.
+   */
+  bool open(const std::string &name, size_t length) {
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if(fd < 0) {
+      std::cerr << "Unable to open shared memory: " << name << std::endl;
+      return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if(ok && st.st_size == 0) ok = ftruncate(fd, length) == 0; // new segment
+    else if(ok && size_t(st.st_size) != length) {
+      std::cerr << "Invalid shared memory size: " << name << " (found: " << st.st_size << ", expected: " << length << ")" << std::endl;
+      ok = false;
+    }
+    if(ok) {
+      data = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if(data == MAP_FAILED) data = 0;
+      else size = length;
+    }
+    ::close(fd);
+    return data != 0;
+  }
+
+  void close() {
+    if(data) munmap(data, size);
+    data = 0;
+    size = 0;
+  }
+
+  // Destroy a named segment, processes having it mapped keep their mapping
+  static void remove(const std::string &name) {
+    shm_unlink(name.c_str());
+  }
+
+  void* get() const {
+    return data;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
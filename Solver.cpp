@@ -16,6 +16,7 @@
  * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include "Solver.hpp"
 #include "MoveSorter.hpp"
@@ -36,50 +37,67 @@ namespace Connect4 {
  * - if actual score of position >= beta then beta <= return value <= actual score
  * - if alpha <= actual score <= beta then return value = actual score
  */
+template<bool Weak>
 int Solver::negamax(const Position &P, int alpha, int beta) {
   assert(alpha < beta);
   assert(!P.canWinNext());
 
+  if(Position::WIDTH * Position::HEIGHT - P.nbMoves() <= LEAF_EMPTY_CELLS) { // small subtree, not worth the table and sorting overhead
+    int val = endgame.get(P); // one endgame table probe still saves the whole subtree search
+    int score = val ? val + Position::MIN_SCORE - 1 : leafDispatch<LEAF_EMPTY_CELLS>(P, alpha, beta);
+    return Weak ? (score > 0) - (score < 0) : score; // the sign keeps the bounds relative to a [-1;1] window
+  }
+
   nodeCount++; // increment counter of explored nodes
 
   Position::position_t possible = P.possibleNonLosingMoves();
   if(possible == 0)     // if no possible non losing move, opponent wins next move
-    return -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+    return Weak ? -1 : -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
 
   if(P.nbMoves() >= Position::WIDTH * Position::HEIGHT - 2) // check for draw game
     return 0;
 
-  int min = -(Position::WIDTH * Position::HEIGHT - 2 - P.nbMoves()) / 2;	// lower bound of score as opponent cannot win next move
-  if(alpha < min) {
-    alpha = min;                     // there is no need to keep alpha below our max possible score.
+  const Position::position_t key = P.key();
+  int lower, upper; // known bounds of the score, they are kept when saving a new bound of the position
+  if constexpr(Weak) { // the [-1;1] window never goes beyond the bounds of the score
+    const int entry = weakTable->get(key);
+    lower = (entry >> 2) - 1;
+    upper = 1 - (entry & 3);
+  } else {
+    int min = -(Position::WIDTH * Position::HEIGHT - 2 - P.nbMoves()) / 2;	// lower bound of score as opponent cannot win next move
+    if(alpha < min) {
+      alpha = min;                     // there is no need to keep alpha below our max possible score.
+      if(alpha >= beta) return alpha;  // prune the exploration if the [alpha;beta] window is empty.
+    }
+
+    int max = (Position::WIDTH * Position::HEIGHT - 1 - P.nbMoves()) / 2;	// upper bound of our score as we cannot win immediately
+    if(beta > max) {
+      beta = max;                     // there is no need to keep beta above our max possible score.
+      if(alpha >= beta) return beta;  // prune the exploration if the [alpha;beta] window is empty.
+    }
+
+    const int entry = transTable.get(key);
+    lower = (entry >> 8) ? (entry >> 8) - BOUND_OFFSET : min;
+    upper = (entry & 0xff) ? (entry & 0xff) - BOUND_OFFSET : max;
+  }
+  if(lower == upper) return lower; // bounds meet: the score is exact
+  if(alpha < lower) {
+    alpha = lower;                   // there is no need to keep alpha below our known lower bound.
     if(alpha >= beta) return alpha;  // prune the exploration if the [alpha;beta] window is empty.
   }
-
-  int max = (Position::WIDTH * Position::HEIGHT - 1 - P.nbMoves()) / 2;	// upper bound of our score as we cannot win immediately
-  if(beta > max) {
-    beta = max;                     // there is no need to keep beta above our max possible score.
-    if(alpha >= beta) return beta;  // prune the exploration if the [alpha;beta] window is empty.
+  if(beta > upper) {
+    beta = upper;                    // there is no need to keep beta above our known upper bound.
+    if(alpha >= beta) return beta;   // prune the exploration if the [alpha;beta] window is empty.
   }
 
-  const Position::position_t key = P.key();
-  if(int val = transTable.get(key)) {
-    if(val > Position::MAX_SCORE - Position::MIN_SCORE + 1) { // we have an lower bound
-      min = val + 2 * Position::MIN_SCORE - Position::MAX_SCORE - 2;
-      if(alpha < min) {
-        alpha = min;                     // there is no need to keep beta above our max possible score.
-        if(alpha >= beta) return alpha;  // prune the exploration if the [alpha;beta] window is empty.
-      }
-    } else { // we have an upper bound
-      max = val + Position::MIN_SCORE - 1;
-      if(beta > max) {
-        beta = max;                     // there is no need to keep beta above our max possible score.
-        if(alpha >= beta) return beta;  // prune the exploration if the [alpha;beta] window is empty.
-      }
-    }
+  int val = book->get(P); // look for solutions stored in opening book
+  if(!val) val = endgame.get(P); // look for solutions stored in endgame table
+  if(val) {
+    int score = val + Position::MIN_SCORE - 1;
+    return Weak ? (score > 0) - (score < 0) : score;
   }
 
-  if(int val = book.get(P)) return val + Position::MIN_SCORE - 1; // look for solutions stored in opening book
-
+  possible = P.removeMirroredMoves(possible); // mirrored moves of a symmetric position have the same score
   MoveSorter moves;
   for(int i = Position::WIDTH; i--;)
     if(Position::position_t move = possible & Position::column_mask(columnOrder[i]))
@@ -88,59 +106,221 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
   while(Position::position_t next = moves.getNext()) {
     Position P2(P);
     P2.play(next);  // It's opponent turn in P2 position after current player plays x column.
-    int score = -negamax(P2, -beta, -alpha); // explore opponent's score within [-beta;-alpha] windows:
+    int score = -negamax<Weak>(P2, -beta, -alpha); // explore opponent's score within [-beta;-alpha] windows:
     // no need to have good precision for score better than beta (opponent's score worse than -beta)
     // no need to check for score worse than alpha (opponent's score worse better than -alpha)
 
-    if(score >= beta) {
-      transTable.put(key, score + Position::MAX_SCORE - 2 * Position::MIN_SCORE + 2); // save the lower bound of the position
+    if(score >= beta) { // save the lower bound of the position
+      if constexpr(Weak) weakTable->put(key, encodeWeakBounds(score, upper));
+      else transTable.put(key, encodeBounds(score, upper));
       return score;  // prune the exploration if we find a possible move better than what we were looking for.
     }
     if(score > alpha) alpha = score; // reduce the [alpha;beta] window for next exploration, as we only
     // need to search for a position that is better than the best so far.
   }
 
-  transTable.put(key, alpha - Position::MIN_SCORE + 1); // save the upper bound of the position
+  // save the upper bound of the position
+  if constexpr(Weak) weakTable->put(key, encodeWeakBounds(lower, alpha));
+  else transTable.put(key, encodeBounds(lower, alpha));
   return alpha;
 }
 
-int Solver::solve(const Position &P, bool weak) {
+template<int Empty>
+int Solver::leafSearch(const Position &P, int alpha, int beta) {
+  assert(alpha < beta);
+  assert(!P.canWinNext());
+  assert(Position::WIDTH * Position::HEIGHT - P.nbMoves() == Empty);
+
+  nodeCount++; // increment counter of explored nodes
+
+  Position::position_t possible = P.possibleNonLosingMoves();
+  if(possible == 0)     // if no possible non losing move, opponent wins next move
+    return -Empty / 2;
+
+  if constexpr(Empty <= 2) return 0; // draw game
+  else {
+    int min = -(Empty - 2) / 2;      // lower bound of score as opponent cannot win next move
+    if(alpha < min) {
+      alpha = min;
+      if(alpha >= beta) return alpha;
+    }
+    int max = (Empty - 1) / 2;       // upper bound of our score as we cannot win immediately
+    if(beta > max) {
+      beta = max;
+      if(alpha >= beta) return beta;
+    }
+
+    for(int i = 0; i < Position::WIDTH; i++) // static center first ordering
+      if(Position::position_t move = possible & Position::column_mask(columnOrder[i])) {
+        Position P2(P);
+        P2.play(move);
+        int score = -leafSearch<Empty - 1>(P2, -beta, -alpha);
+        if(score >= beta) return score;
+        if(score > alpha) alpha = score;
+      }
+    return alpha;
+  }
+}
+
+template<int Max>
+int Solver::leafDispatch(const Position &P, int alpha, int beta) {
+  if constexpr(Max > 1) {
+    if(Position::WIDTH * Position::HEIGHT - P.nbMoves() < Max) return leafDispatch<Max - 1>(P, alpha, beta);
+  }
+  return leafSearch<Max>(P, alpha, beta);
+}
+
+template int Solver::leafDispatch<Solver::LEAF_EMPTY_CELLS>(const Position &P, int alpha, int beta); // used by StepSolver
+
+int Solver::solve(const Position &P, bool weak, WeakEngine engine) {
   if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
     return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
-  int min = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
-  int max = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  if(weak && engine == WeakEngine::PROOF_NUMBER) {
+    if(!pnSolver) pnSolver.reset(new ProofNumberSolver());
+    unsigned long long previousCount = pnSolver->getNodeCount();
+    int score = pnSolver->solve(P);
+    nodeCount += pnSolver->getNodeCount() - previousCount;
+    return score;
+  }
   if(weak) {
-    min = -1;
-    max = 1;
+    if(!weakTable) weakTable.reset(new WeakTable());
+    int r = negamax<true>(P, 0, 1);     // is the position a win or at least a draw?
+    return r <= 0 ? negamax<true>(P, -1, 0) : r;
   }
+  return solveWithin(P, -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2, (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2);
+}
 
+int Solver::solveWithin(const Position &P, int min, int max) {
   while(min < max) {                    // iteratively narrow the min-max exploration window
     int med = min + (max - min) / 2;
     if(med <= 0 && min / 2 < med) med = min / 2;
     else if(med >= 0 && max / 2 > med) med = max / 2;
-    int r = negamax(P, med, med + 1);   // use a null depth window to know if the actual score is greater or smaller than med
+    int r = negamax<false>(P, med, med + 1); // use a null depth window to know if the actual score is greater or smaller than med
     if(r <= med) max = r;
     else min = r;
   }
   return min;
 }
 
-std::vector<int> Solver::analyze(const Position &P, bool weak) {
+int Solver::solveWithGuess(const Position &P, int guess) {
+  if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
+    return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+  int min = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+  int max = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+
+  int med = guess;
+  while(min < max) {                    // iteratively narrow the min-max exploration window around the guess
+    if(med < min) med = min;
+    else if(med >= max) med = max - 1;
+    int r = negamax<false>(P, med, med + 1); // use a null depth window to know if the actual score is greater or smaller than med
+    if(r <= med) {
+      max = r;
+      med = r - 1;                      // next probe checks if the score is exactly the upper bound r
+    }
+    else {
+      min = r;
+      med = r;                          // next probe checks if the score is exactly the lower bound r
+    }
+  }
+  return min;
+}
+
+std::vector<int> Solver::analyze(const Position &P, bool weak, WeakEngine engine) {
   std::vector<int> scores(Position::WIDTH, Solver::INVALID_MOVE);
+  const bool symmetric = P.isSymmetric();
   for (int col = 0; col < Position::WIDTH; col++)
     if (P.canPlay(col)) {
-      if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+      if(symmetric && col > Position::WIDTH - 1 - col) scores[col] = scores[Position::WIDTH - 1 - col]; // same score as the mirrored move
+      else if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
       else {
         Position P2(P);
         P2.playCol(col);
-        scores[col] = -solve(P2, weak);
+        scores[col] = -solve(P2, weak, engine);
       }
     }
   return scores;
 }
 
+int Solver::bestMove(const Position &P) {
+  int best = bookMove(P);
+  return best >= 0 ? best : bestColumn(analyze(P));
+}
+
+int Solver::bestColumn(const std::vector<int> &scores) {
+  int best = -1;
+  for(int i = 0; i < Position::WIDTH; i++) { // center columns first
+    int col = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+    if(scores[col] != Solver::INVALID_MOVE && (best < 0 || scores[col] > scores[best])) best = col;
+  }
+  return best;
+}
+
+std::vector<int> Solver::analyzeProgressive(const Position &P, const std::function<void(int column, int score, bool exact)> &update) {
+  std::vector<int> scores(Position::WIDTH, Solver::INVALID_MOVE);
+  std::vector<int> pending; // playable columns only weakly solved
+  const bool symmetric = P.isSymmetric();
+  for (int col = 0; col < Position::WIDTH; col++)
+    if (P.canPlay(col)) {
+      bool exact = true;
+      const int mirror = Position::WIDTH - 1 - col;
+      if(symmetric && col > mirror) { // same score as the mirrored move, refined with it
+        scores[col] = scores[mirror];
+        exact = std::find(pending.begin(), pending.end(), mirror) == pending.end();
+      }
+      else if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+      else {
+        Position P2(P);
+        P2.playCol(col);
+        scores[col] = -solve(P2, true); // exact when the opponent can win next move
+        exact = scores[col] == 0 || P2.canWinNext(); // a draw is already the exact score
+        if(!exact) pending.push_back(col);
+      }
+      update(col, scores[col], exact);
+    }
+
+  for(int col : pending) {
+    Position P2(P);
+    P2.playCol(col);
+    if(scores[col] > 0) scores[col] = -solveWithin(P2, -(Position::WIDTH * Position::HEIGHT - P2.nbMoves()) / 2, -1); // the opponent loses
+    else scores[col] = -solveWithin(P2, 1, (Position::WIDTH * Position::HEIGHT + 1 - P2.nbMoves()) / 2);             // the opponent wins
+    update(col, scores[col], true);
+    const int mirror = Position::WIDTH - 1 - col;
+    if(symmetric && mirror != col) {
+      scores[mirror] = scores[col];
+      update(mirror, scores[mirror], true);
+    }
+  }
+  return scores;
+}
+
+std::vector<Solver::MoveAnalysis> Solver::analyzeGame(const std::string &moves, bool weak) {
+  std::vector<Position> positions; // position before each valid move
+  std::vector<int> columns;
+  Position P;
+  for(char c : moves) {
+    int col = c - '1';
+    if(col < 0 || col >= Position::WIDTH || !P.canPlay(col)) break; // invalid move
+    positions.push_back(P);
+    columns.push_back(col);
+    if(P.isWinningMove(col)) break; // end of the game
+    P.playCol(col);
+  }
+
+  std::vector<MoveAnalysis> game(positions.size());
+  for(size_t i = positions.size(); i--;) { // deepest positions first
+    MoveAnalysis &m = game[i];
+    m.column = columns[i];
+    m.scores = analyze(positions[i], weak);
+    int best = Solver::INVALID_MOVE;
+    for(int score : m.scores) if(score > best) best = score;
+    const int played = m.scores[m.column];
+    m.blunder = (played > 0) - (played < 0) < (best > 0) - (best < 0);
+  }
+  return game;
+}
+
 // Constructor
-Solver::Solver() : nodeCount{0} {
+Solver::Solver() : book{std::make_shared<OpeningBook>(Position::WIDTH, Position::HEIGHT)}, nodeCount{0} {
   for(int i = 0; i < Position::WIDTH; i++) // initialize the column exploration order, starting with center columns
     columnOrder[i] = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2; // example for WIDTH=7: columnOrder = {3, 4, 2, 5, 1, 6, 0}
 }
@@ -21,9 +21,13 @@
 
 #include <vector>
 #include <string>
+#include <memory>
+#include <functional>
 #include "Position.hpp"
 #include "TranspositionTable.hpp"
 #include "OpeningBook.hpp"
+#include "EndgameTable.hpp"
+#include "ProofNumberSolver.hpp"
 
 namespace GameSolver {
 namespace Connect4 {
@@ -31,10 +35,39 @@ namespace Connect4 {
 class Solver {
  private:
   static constexpr int TABLE_SIZE = 24; // store 2^TABLE_SIZE elements in the transpositiontbale
-  TranspositionTable < uint_t < Position::WIDTH*(Position::HEIGHT + 1) - TABLE_SIZE >, Position::position_t, uint8_t, TABLE_SIZE > transTable;
-  OpeningBook book{Position::WIDTH, Position::HEIGHT}; // opening book
+  TranspositionTable < uint_t < Position::WIDTH*(Position::HEIGHT + 1) - TABLE_SIZE >, Position::position_t, uint16_t, TABLE_SIZE > transTable;
+  std::shared_ptr<const OpeningBook> book; // opening book, possibly shared with other solvers
+  EndgameTable endgame; // endgame tablebase
   unsigned long long nodeCount; // counter of explored nodes.
   int columnOrder[Position::WIDTH]; // column exploration order
+  std::unique_ptr<ProofNumberSolver> pnSolver; // weak solver allocated on first use
+
+  /**
+   * Weak search only needs the sign of the score: its table packs 2 bits bounds
+   * with a 25 bits truncated key and a 3 bits generation in 32 bits entries.
+   * - 2 low bits: 1 - upper bound, 0 if unknown (upper bound 1)
+   * - 2 high bits: lower bound + 1, 0 if unknown (lower bound -1)
+   */
+  static constexpr int WEAK_TABLE_SIZE = 24; // store 2^WEAK_TABLE_SIZE elements in the weak transposition table
+  using WeakTable = PackedTranspositionTable<Position::position_t, Position::WIDTH*(Position::HEIGHT + 1), 4, WEAK_TABLE_SIZE>;
+  std::unique_ptr<WeakTable> weakTable; // allocated on first weak solve
+
+  /**
+   * Transposition table entries keep both a lower and an upper bound of the score,
+   * so that successive null window searches with shifted windows keep getting cutoffs:
+   * - 8 low bits: upper bound + BOUND_OFFSET, 0 if unknown
+   * - 8 high bits: lower bound + BOUND_OFFSET, 0 if unknown
+   * The score is exact when both bounds are equal.
+   */
+  static constexpr int BOUND_OFFSET = Position::WIDTH * Position::HEIGHT / 2 + 1; // encoded bounds are always > 0
+
+  static uint16_t encodeBounds(int lower, int upper) {
+    return (lower + BOUND_OFFSET) << 8 | (upper + BOUND_OFFSET);
+  }
+
+  static uint32_t encodeWeakBounds(int lower, int upper) {
+    return (lower + 1) << 2 | (1 - upper);
+  }
 
   /**
    * Reccursively score connect 4 position using negamax variant of alpha-beta algorithm.
@@ -46,18 +79,87 @@ class Solver {
    * - if actual score of position <= alpha then actual score <= return value <= alpha
    * - if actual score of position >= beta then beta <= return value <= actual score
    * - if alpha <= actual score <= beta then return value = actual score
+   *
+   * Weak: when true, scores are only -1 (loss), 0 (draw) or 1 (win) and the weak table is used.
    */
+  template<bool Weak>
   int negamax(const Position &P, int alpha, int beta);
 
+  // Exact score of a position known to be within [min;max], the current player cannot win next move
+  int solveWithin(const Position &P, int min, int max);
+
+  static constexpr int LEAF_EMPTY_CELLS = 10; // positions with at most this number of empty cells are solved by leafSearch
+
+  /**
+   * Same contract as negamax, for positions with exactly Empty empty cells.
+   * Plain alpha-beta without transposition table, book or move sorting, the
+   * recursion is unrolled at compile time down to the end of the game.
+   */
+  template<int Empty>
+  int leafSearch(const Position &P, int alpha, int beta);
+
+  // call leafSearch<Empty> for the actual number of empty cells of P, which must not exceed Max
+  template<int Max>
+  int leafDispatch(const Position &P, int alpha, int beta);
+
  public:
   static const int INVALID_MOVE = -1000;
 
+  // Search algorithm used for weak solving
+  enum class WeakEngine {
+    NEGAMAX,     // alpha-beta negamax with a [-1;1] window
+    PROOF_NUMBER // depth-first proof-number search, see ProofNumberSolver
+  };
+
   // Returns the score of a position
-  int solve(const Position &P, bool weak = false);
+  int solve(const Position &P, bool weak = false, WeakEngine engine = WeakEngine::NEGAMAX);
+
+  // Returns the score of a position, using MTD(f) null window searches starting from a score guess.
+  // A close guess (e.g. the opposite of the score of the previous position) saves many iterations.
+  int solveWithGuess(const Position &P, int guess);
 
   // Returns the score off all possible moves of a position as an array.
   // Returns INVALID_MOVE for unplayable columns
-  std::vector<int> analyze(const Position &P, bool weak = false);
+  std::vector<int> analyze(const Position &P, bool weak = false, WeakEngine engine = WeakEngine::NEGAMAX);
+
+  // Returns the best column to play (0-based) stored in the opening book, -1 if unknown
+  int bookMove(const Position &P) const {
+    return book->getMove(P);
+  }
+
+  // Returns the best column (0-based) given the scores of all the moves as returned by analyze(),
+  // the one closest to the center among the best ones, -1 if no move is possible.
+  static int bestColumn(const std::vector<int> &scores);
+
+  // Returns the best column to play (0-based), -1 if no move is possible.
+  // The opening book is used when it knows the position, otherwise all the moves are analyzed
+  // and the one closest to the center is preferred among the best ones.
+  int bestMove(const Position &P);
+
+  /**
+   * Same result as analyze(), delivered progressively: all the columns are first weakly
+   * solved, then the winning and losing ones are refined to their exact score, knowing
+   * the sign of their score. Draws and immediate wins are exact from the first pass.
+   * @param update: called for every playable column with its weak score (-1, 0 or 1)
+   *        and called again with its exact score (exact = true) once known.
+   */
+  std::vector<int> analyzeProgressive(const Position &P, const std::function<void(int column, int score, bool exact)> &update);
+
+  // Analysis of one move of a game
+  struct MoveAnalysis {
+    int column;              // 0-based index of the played column
+    std::vector<int> scores; // scores of all the moves of the position before the move, as returned by analyze()
+    bool blunder;            // the played move turns a win into a draw or a loss, or a draw into a loss
+  };
+
+  /**
+   * Analyze every move of a game.
+   * Positions are solved from the last one to the first one, so that the transposition table
+   * filled by the deepest positions speeds up the earlier ones.
+   * @param moves: sequence of 1-based played columns, possibly ending with a winning move.
+   * @return one analysis per move, the analysis stops before the first invalid move.
+   */
+  std::vector<MoveAnalysis> analyzeGame(const std::string &moves, bool weak = false);
 
   unsigned long long getNodeCount() const {
     return nodeCount;
@@ -66,13 +168,26 @@ class Solver {
   void reset() {
     nodeCount = 0;
     transTable.reset();
+    if(weakTable) weakTable->reset();
+    if(pnSolver) pnSolver->reset();
   }
 
   void loadBook(std::string book_file) {
-    book.load(book_file);
+    book = OpeningBook::loadShared(book_file);
+  }
+
+  // Use an already loaded opening book
+  void setBook(std::shared_ptr<const OpeningBook> shared_book) {
+    book = std::move(shared_book);
+  }
+
+  void loadEndgameTable(std::string table_file) {
+    endgame.load(table_file);
   }
 
   Solver(); // Constructor
+
+  friend class StepSolver; // resumable search sharing the tables of a Solver
 };
 
 } // namespace Connect4
@@ -0,0 +1,172 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SORTED_RUNS_HPP
+#define SORTED_RUNS_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Files of records sorted by key, used to process sets too large for memory
+ * with an external merge sort.
+ *
+ * A run is written in increasing order of keys. Keys are delta encoded, and keys
+ * and data are stored as variable length integers (7 bits per byte, high bit set
+ * on all bytes but the last one), so that dense sorted sets of keys take a few
+ * bytes per record.
+ */
+struct Record {
+  uint64_t key;
+  uint64_t data;
+
+  bool operator<(const Record &other) const {
+    return key < other.key;
+  }
+};
+
+class RunWriter {
+  FILE *file;
+  uint64_t last; // previous key
+  uint64_t count;
+
+  void putVarint(uint64_t v) {
+    while(v >= 0x80) {
+      putc(int(v & 0x7f) | 0x80, file);
+      v >>= 7;
+    }
+    putc(int(v), file);
+  }
+
+ public:
+  explicit RunWriter(const std::string &filename) : file{fopen(filename.c_str(), "wb")}, last{0}, count{0} {}
+
+  RunWriter(const RunWriter&) = delete;
+  RunWriter& operator=(const RunWriter&) = delete;
+
+  ~RunWriter() {
+    close();
+  }
+
+  bool ok() const {
+    return file != 0;
+  }
+
+  // Append a record, its key must be greater than or equal to the key of the previous one
+  void write(const Record &r) {
+    putVarint(r.key - last);
+    putVarint(r.data);
+    last = r.key;
+    count++;
+  }
+
+  uint64_t size() const {
+    return count;
+  }
+
+  // @return false if some data could not be written
+  bool close() {
+    if(!file) return true;
+    bool success = !ferror(file);
+    success &= fclose(file) == 0;
+    file = 0;
+    return success;
+  }
+};
+
+class RunReader {
+  FILE *file;
+  uint64_t last; // previous key
+
+  bool getVarint(uint64_t &v) {
+    v = 0;
+    for(int shift = 0; shift < 64; shift += 7) {
+      int c = getc(file);
+      if(c == EOF) return false;
+      v |= uint64_t(c & 0x7f) << shift;
+      if(!(c & 0x80)) return true;
+    }
+    return false;
+  }
+
+ public:
+  explicit RunReader(const std::string &filename) : file{fopen(filename.c_str(), "rb")}, last{0} {}
+
+  RunReader(const RunReader&) = delete;
+  RunReader& operator=(const RunReader&) = delete;
+
+  ~RunReader() {
+    if(file) fclose(file);
+  }
+
+  bool ok() const {
+    return file != 0;
+  }
+
+  // Read the next record, return false at the end of the run
+  bool read(Record &r) {
+    uint64_t delta;
+    if(!file || !getVarint(delta) || !getVarint(r.data)) return false;
+    r.key = last += delta;
+    return true;
+  }
+};
+
+/**
+ * Merge sorted runs, calling f(record) once per distinct key in increasing order of keys.
+ * For a key present in several runs, the record of the first run holding it is kept.
+ * @return false if a run cannot be opened.
+ */
+template<class F>
+bool mergeRuns(const std::vector<std::string> &runs, F f) {
+  std::vector<std::unique_ptr<RunReader>> readers;
+  using Head = std::pair<Record, size_t>; // next record of a run and index of the run
+  auto later = [](const Head &a, const Head &b) {
+    return b.first.key < a.first.key || (a.first.key == b.first.key && b.second < a.second);
+  };
+  std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+  for(const std::string &run : runs) {
+    readers.emplace_back(new RunReader(run));
+    if(!readers.back()->ok()) return false;
+    Record r;
+    if(readers.back()->read(r)) heads.emplace(r, readers.size() - 1);
+  }
+  bool first = true;
+  uint64_t previous = 0;
+  while(!heads.empty()) {
+    Head h = heads.top();
+    heads.pop();
+    if(first || h.first.key != previous) f(h.first);
+    first = false;
+    previous = h.first.key;
+    Record r;
+    if(readers[h.second]->read(r)) heads.emplace(r, h.second);
+  }
+  return true;
+}
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
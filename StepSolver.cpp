@@ -0,0 +1,203 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cassert>
+#include "StepSolver.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+bool StepSolver::enter(const Position &P, int alpha, int beta) {
+  assert(alpha < beta);
+  assert(!P.canWinNext());
+
+  if(Position::WIDTH * Position::HEIGHT - P.nbMoves() <= Solver::LEAF_EMPTY_CELLS) { // small subtree, solved in one go
+    if(int val = solver.endgame.get(P)) { // unless the endgame table knows it
+      value = val + Position::MIN_SCORE - 1;
+      return true;
+    }
+    unsigned long long previousCount = solver.nodeCount;
+    value = solver.leafDispatch<Solver::LEAF_EMPTY_CELLS>(P, alpha, beta);
+    nodeCount += solver.nodeCount - previousCount;
+    return true;
+  }
+
+  nodeCount++;
+
+  Position::position_t possible = P.possibleNonLosingMoves();
+  if(possible == 0) {   // if no possible non losing move, opponent wins next move
+    value = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+    return true;
+  }
+
+  if(P.nbMoves() >= Position::WIDTH * Position::HEIGHT - 2) { // check for draw game
+    value = 0;
+    return true;
+  }
+
+  int min = -(Position::WIDTH * Position::HEIGHT - 2 - P.nbMoves()) / 2;	// lower bound of score as opponent cannot win next move
+  if(alpha < min) {
+    alpha = min;
+    if(alpha >= beta) {
+      value = alpha;
+      return true;
+    }
+  }
+
+  int max = (Position::WIDTH * Position::HEIGHT - 1 - P.nbMoves()) / 2;	// upper bound of our score as we cannot win immediately
+  if(beta > max) {
+    beta = max;
+    if(alpha >= beta) {
+      value = beta;
+      return true;
+    }
+  }
+
+  const Position::position_t key = P.key();
+  const int entry = solver.transTable.get(key);
+  const int lower = (entry >> 8) ? (entry >> 8) - Solver::BOUND_OFFSET : min;
+  const int upper = (entry & 0xff) ? (entry & 0xff) - Solver::BOUND_OFFSET : max;
+  if(lower == upper) {
+    value = lower;
+    return true;
+  }
+  if(alpha < lower) {
+    alpha = lower;
+    if(alpha >= beta) {
+      value = alpha;
+      return true;
+    }
+  }
+  if(beta > upper) {
+    beta = upper;
+    if(alpha >= beta) {
+      value = beta;
+      return true;
+    }
+  }
+
+  int val = solver.book->get(P); // look for solutions stored in opening book
+  if(!val) val = solver.endgame.get(P); // look for solutions stored in endgame table
+  if(val) {
+    value = val + Position::MIN_SCORE - 1;
+    return true;
+  }
+
+  stack.emplace_back();
+  Frame &f = stack.back();
+  f.P = P;
+  f.key = key;
+  f.alpha = alpha;
+  f.beta = beta;
+  f.lower = lower;
+  f.upper = upper;
+  possible = P.removeMirroredMoves(possible); // mirrored moves of a symmetric position have the same score
+  for(int i = Position::WIDTH; i--;)
+    if(Position::position_t move = possible & Position::column_mask(solver.columnOrder[i]))
+      f.moves.add(move, P.moveScore(move));
+  return false;
+}
+
+void StepSolver::nextProbe() {
+  if(min >= max) {
+    finished = true;
+    score = weak ? (min > 0) - (min < 0) : min;
+    return;
+  }
+  if(useGuess) {
+    if(med < min) med = min;
+    else if(med >= max) med = max - 1;
+  } else {
+    med = min + (max - min) / 2;
+    if(med <= 0 && min / 2 < med) med = min / 2;
+    else if(med >= 0 && max / 2 > med) med = max / 2;
+  }
+  returning = enter(root, med, med + 1); // use a null depth window to know if the actual score is greater or smaller than med
+}
+
+bool StepSolver::step(unsigned long long maxNodes) {
+  const unsigned long long limit = nodeCount + maxNodes;
+  while(!finished && nodeCount < limit) {
+    if(returning) {
+      if(stack.empty()) { // end of a null window search, value is the score of the root
+        if(value <= med) {
+          max = value;
+          med = value - 1; // used by MTD(f) only: next probe checks if the score is exactly the upper bound
+        } else {
+          min = value;
+          med = value;     // used by MTD(f) only: next probe checks if the score is exactly the lower bound
+        }
+        nextProbe();
+        continue;
+      }
+      Frame &f = stack.back();
+      int childScore = -value;
+      if(childScore >= f.beta) {
+        solver.transTable.put(f.key, Solver::encodeBounds(childScore, f.upper)); // save the lower bound of the position
+        value = childScore;
+        stack.pop_back();
+        continue;
+      }
+      if(childScore > f.alpha) f.alpha = childScore;
+    }
+
+    Frame &f = stack.back();
+    if(Position::position_t next = f.moves.getNext()) {
+      Position P2(f.P);
+      P2.play(next);
+      returning = enter(P2, -f.beta, -f.alpha); // f is invalidated if a frame is pushed
+    } else {
+      solver.transTable.put(f.key, Solver::encodeBounds(f.lower, f.alpha)); // save the upper bound of the position
+      value = f.alpha;
+      stack.pop_back();
+      returning = true;
+    }
+  }
+  return finished;
+}
+
+void StepSolver::init(const Position &P, bool weakSolve) {
+  root = P;
+  stack.clear();
+  weak = weakSolve;
+  useGuess = false;
+  finished = P.canWinNext(); // check if win in one move as enter() does not support this case
+  if(finished) score = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2; // exact even when weak, as Solver::solve
+  min = weak ? -1 : -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+  max = weak ? 1 : (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+}
+
+void StepSolver::start(const Position &P, bool weakSolve) {
+  init(P, weakSolve);
+  if(!finished) nextProbe();
+}
+
+void StepSolver::startWithGuess(const Position &P, int guess) {
+  init(P, false);
+  useGuess = true;
+  med = guess;
+  if(!finished) nextProbe();
+}
+
+StepSolver::StepSolver(Solver &solver) :
+  solver(solver), min{0}, max{0}, med{0}, weak{false}, useGuess{false}, finished{true}, score{0}, value{0}, returning{false}, nodeCount{0} {
+  stack.reserve(Position::WIDTH * Position::HEIGHT);
+}
+
+} // namespace Connect4
+} // namespace GameSolver
@@ -0,0 +1,123 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STEP_SOLVER_HPP
+#define STEP_SOLVER_HPP
+
+#include <vector>
+#include "Position.hpp"
+#include "MoveSorter.hpp"
+#include "Solver.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Resumable solver advancing a search by bounded amounts of work.
+ *
+ * The negamax recursion of Solver is replaced by an explicit stack of frames,
+ * so that a search can be suspended after any number of nodes and resumed
+ * later. A single thread can then interleave many searches, for instance
+ * one step per frame of a GUI or per iteration of an event loop.
+ *
+ * The transposition table, opening book and endgame table of the Solver given
+ * at construction are shared: searches of the Solver and of any number of
+ * StepSolver can be interleaved on the same thread, but not run concurrently.
+ */
+class StepSolver {
+ private:
+  struct Frame {
+    Position P;
+    Position::position_t key;
+    int alpha;
+    int beta;
+    int lower;  // known bounds of the score, as in Solver::negamax
+    int upper;
+    MoveSorter moves; // remaining moves to explore
+  };
+
+  Solver &solver;
+  Position root;
+  std::vector<Frame> stack; // frames of the current null window search, empty between searches
+  int min, max;   // bounds of the root score
+  int med;        // the current null window search is [med; med + 1]
+  bool weak;      // only compute win/draw/loss
+  bool useGuess;  // MTD(f) probes around a guess instead of bisection
+  bool finished;
+  int score;      // score of the root once finished
+  int value;      // score returned by the last completed node
+  bool returning; // value has to be propagated to the top frame
+  unsigned long long nodeCount;
+
+  /**
+   * Start exploring a node, as the beginning of Solver::negamax.
+   * @return true if the node is solved without exploring its children (value is set),
+   *         false if a frame was pushed.
+   */
+  bool enter(const Position &P, int alpha, int beta);
+
+  // Initialize a new search of P, the search is already finished if P can win next move
+  void init(const Position &P, bool weakSolve);
+
+  // Start the next null window search, or finish when the root score is known
+  void nextProbe();
+
+ public:
+  /**
+   * @param solver: solver whose tables are used, it must outlive the StepSolver.
+   */
+  explicit StepSolver(Solver &solver);
+
+  /**
+   * Start solving a position, cancelling any unfinished search.
+   * @param weakSolve: only compute win/draw/loss.
+   */
+  void start(const Position &P, bool weakSolve = false);
+
+  /**
+   * Start solving a position with MTD(f) null window searches starting from a score guess,
+   * see Solver::solveWithGuess.
+   */
+  void startWithGuess(const Position &P, int guess);
+
+  /**
+   * Continue the search.
+   * @param maxNodes: approximate number of nodes to explore before returning.
+   * @return true if the search is finished.
+   */
+  bool step(unsigned long long maxNodes);
+
+  bool done() const {
+    return finished;
+  }
+
+  // Score of the position, only meaningful once the search is done.
+  // Same result as Solver::solve: the exact score if the current player can win next move, even for a weak search.
+  int result() const {
+    return score;
+  }
+
+  // Number of nodes explored since construction
+  unsigned long long getNodeCount() const {
+    return nodeCount;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
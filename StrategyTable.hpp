@@ -0,0 +1,87 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRATEGY_TABLE_HPP
+#define STRATEGY_TABLE_HPP
+
+#include <iostream>
+#include "Position.hpp"
+#include "MappedTable.hpp"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Perfect play strategy of one side, exported by the strategy tool (see strategy.cpp).
+ *
+ * For every position of the side where it is its turn to play, and that can be reached
+ * from the root of the strategy when the side follows it, the table gives one move
+ * keeping the best reachable result. Playing is then a single lookup, without any search.
+ *
+ * Positions are identified by their symmetricKey(), as key3() overflows close to the end
+ * of the game. Values are 1 + the column to play, as seen from the orientation of the
+ * position whose key() is the smallest of the position and its mirror image.
+ * The table specific parameter of the file is 1 if the side is the first player, 2 otherwise.
+ */
+class StrategyTable {
+  static_assert(Position::WIDTH * (Position::HEIGHT + 1) <= 64, "Strategy table keys are limited to 64 bits");
+
+  MappedTable T;
+  int side; // 1 or 2, 0 for an empty table
+
+ public:
+  StrategyTable() : side{0} {} // Empty table
+
+  bool load(const std::string &filename) {
+    side = 0;
+    int param;
+    if(!T.load(filename, Position::WIDTH, Position::HEIGHT, param)) return false;
+    if(param != 1 && param != 2) {
+      std::cerr << "Unable to load strategy: invalid side " << param << " in " << filename << std::endl;
+      return false;
+    }
+    side = param;
+    return true;
+  }
+
+  // Side playing the strategy: 1 for the first player, 2 for the second one, 0 if no strategy is loaded
+  int getSide() const {
+    return side;
+  }
+
+  /**
+   * @return the column to play (0-based), -1 if it is not the turn of the side or if
+   * the position is not reachable when the side follows the strategy.
+   */
+  int getMove(const Position &P) const {
+    if(side == 0 || P.nbMoves() % 2 != side - 1) return -1;
+    const Position::position_t key = P.key();
+    const Position::position_t mirror = P.mirrorKey();
+    const int value = T.get(key < mirror ? key : mirror);
+    if(!value) return -1;
+    return mirror < key ? Position::WIDTH - value : value - 1;
+  }
+
+  size_t getSize() const {
+    return T.getSize();
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
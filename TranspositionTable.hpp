@@ -20,6 +20,7 @@
 #define TRANSPOSITION_TABLE_HPP
 
 #include <cstring>
+#include <atomic>
 
 namespace GameSolver {
 namespace Connect4 {
@@ -61,6 +62,8 @@ class TableGetter {
   virtual size_t getSize() = 0;
   virtual int getKeySize() = 0;
   virtual int getValueSize() = 0;
+  virtual size_t locate(key_t key) const = 0; // index of the entry of key, getSize() if missing
+  virtual void put(key_t key, value_t value) = 0;
 
  public:
   virtual value_t get(key_t key) const = 0;
@@ -82,6 +85,10 @@ template<int S> using uint_t =
  * In case of collision we keep the last entry and overide the previous one.
  * We keep only part of the key to reduce storage, but no error is possible thanks to Chinese theorem.
  *
+ * Each entry is tagged with the generation of the table when it was stored, entries of
+ * older generations are considered missing. Resetting the table only starts a new generation,
+ * the storage is actually cleared once every 256 resets when the generation counter wraps.
+ *
  * The number of stored entries is a power of two that is defined at compile time.
  * We also define size of the entries and keys to allow optimization at compile time.
  *
@@ -96,6 +103,8 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
   static const size_t size = next_prime(1 << log_size); // size of the transition table. Have to be odd to be prime with 2^sizeof(key_t)
   partial_key_t *K;     // Array to store truncated version of keys;
   value_t *V;   // Array to store values;
+  uint8_t *G;   // Array to store the generation of each entry
+  uint8_t generation; // current generation, entries stored with another generation are missing
 
   void* getKeys()    override {return K;}
   void* getValues()  override {return V;}
@@ -107,24 +116,32 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
     return key % size;
   }
 
+  void clear() { // fill everything with 0, because 0 value means missing data
+    memset(K, 0, size * sizeof(partial_key_t));
+    memset(V, 0, size * sizeof(value_t));
+    memset(G, 0, size * sizeof(uint8_t));
+    generation = 0;
+  }
+
  public:
   TranspositionTable() {
     K = new partial_key_t[size];
     V = new value_t[size];
-    reset();
+    G = new uint8_t[size];
+    clear(); // generation 0 matches the entries loaded directly in K and V (see OpeningBook)
   }
 
   ~TranspositionTable() {
     delete[] K;
     delete[] V;
+    delete[] G;
   }
 
   /**
-   * Empty the Transition Table.
+   * Empty the Transition Table in constant time by starting a new generation.
    */
-  void reset() { // fill everything with 0, because 0 value means missing data
-    memset(K, 0, size * sizeof(partial_key_t));
-    memset(V, 0, size * sizeof(value_t));
+  void reset() {
+    if(++generation == 0) clear(); // the generation wrapped around, entries of the new generation could be stale
   }
 
   /**
@@ -132,10 +149,11 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
    * @param key: must be less than key_size bits.
    * @param value: must be less than value_size bits. null (0) value is used to encode missing data
    */
-  void put(key_t key, value_t value) {
+  void put(key_t key, value_t value) override {
     size_t pos = index(key);
     K[pos] = key; // key is possibly trucated as key_t is possibly less than key_size bits.
     V[pos] = value;
+    G[pos] = generation;
   }
 
   /**
@@ -145,7 +163,172 @@ class TranspositionTable : public TableGetter<key_t, value_t> {
    */
   value_t get(key_t key) const override {
     size_t pos = index(key);
-    if(K[pos] == (partial_key_t)key) return V[pos]; // need to cast to key_t because key may be truncated due to size of key_t
+    if(K[pos] == (partial_key_t)key && G[pos] == generation) return V[pos]; // need to cast to key_t because key may be truncated due to size of key_t
+    else return 0;
+  }
+
+  /**
+   * Get the index of the entry of a key, to store data along the table in parallel arrays
+   * @return index of the entry if present, size otherwise.
+   */
+  size_t locate(key_t key) const override {
+    size_t pos = index(key);
+    return K[pos] == (partial_key_t)key && G[pos] == generation ? pos : size;
+  }
+};
+
+/**
+ * Compact Transposition Table for values of a few bits.
+ *
+ * Each entry is a single 32 bits word packing the truncated key, a generation and the value,
+ * so that more entries fit in a cache line than with separate key and value arrays.
+ * Only the key_size - log_size low bits of the key are kept, which is enough thanks to
+ * Chinese theorem, the remaining bits hold the generation used by reset() as in TranspositionTable.
+ *
+ * key_size:   number of bits of the key
+ * value_size: number of bits of the value
+ * log_size:   base 2 log of the size of the Transposition Table.
+ *             The table will contain 2^log_size elements
+ */
+template<class key_t, int key_size, int value_size, int log_size>
+class PackedTranspositionTable {
+ private:
+  static const size_t size = next_prime(1 << log_size); // size of the transition table. Have to be odd to be prime with 2^sizeof(key_t)
+  static constexpr int KEY_BITS = key_size - log_size;  // number of bits of the truncated key
+  static constexpr int GENERATION_BITS = 32 - KEY_BITS - value_size;
+  static_assert(GENERATION_BITS >= 1, "Truncated key and value do not fit in 32 bits");
+  static constexpr uint32_t KEY_MASK = (uint32_t(1) << KEY_BITS) - 1;
+  static constexpr uint32_t VALUE_MASK = (uint32_t(1) << value_size) - 1;
+  static constexpr uint32_t GENERATION_MASK = (uint32_t(1) << GENERATION_BITS) - 1;
+  uint32_t *T;         // Array to store packed keys, generations and values
+  uint32_t generation; // current generation, entries stored with another generation are missing
+
+  // truncated key tagged with the current generation, as stored above the value
+  uint32_t tag(key_t key) const {
+    return (uint32_t(key) & KEY_MASK) << GENERATION_BITS | generation;
+  }
+
+ public:
+  PackedTranspositionTable() : T{new uint32_t[size]}, generation{0} {
+    memset(T, 0, size * sizeof(uint32_t));
+  }
+
+  ~PackedTranspositionTable() {
+    delete[] T;
+  }
+
+  PackedTranspositionTable(const PackedTranspositionTable&) = delete;
+  PackedTranspositionTable& operator=(const PackedTranspositionTable&) = delete;
+
+  /**
+   * Empty the Transition Table in constant time by starting a new generation.
+   */
+  void reset() {
+    generation = (generation + 1) & GENERATION_MASK;
+    if(generation == 0) memset(T, 0, size * sizeof(uint32_t)); // the generation wrapped around
+  }
+
+  /**
+   * Store a value for a given key
+   * @param key: must be less than key_size bits.
+   * @param value: must be less than value_size bits. null (0) value is used to encode missing data
+   */
+  void put(key_t key, uint32_t value) {
+    T[key % size] = tag(key) << value_size | value;
+  }
+
+  /**
+   * Get the value of a key
+   * @param key: must be less than key_size bits.
+   * @return value_size bits value associated with the key if present, 0 otherwise.
+   */
+  uint32_t get(key_t key) const {
+    uint32_t entry = T[key % size];
+    if(entry >> value_size == tag(key)) return entry & VALUE_MASK;
+    else return 0;
+  }
+};
+
+/**
+ * Transposition Table safe for concurrent use by several threads without locks.
+ *
+ * Each entry packs an 8 bits generation, the truncated key (40 low bits) and a 16 bits
+ * value in a single 64 bits word that is read and written atomically. A reader can see
+ * an older or a newer entry, but never a key coming with the value of another position.
+ * As for TranspositionTable, no error is possible thanks to Chinese theorem
+ * as long as keys have less than 40 + log_size bits, and reset() only starts
+ * a new generation.
+ *
+ * The current generation is stored after the entries, so that processes sharing
+ * the storage also share the resets.
+ *
+ * log_size:   base 2 log of the size of the Transposition Table.
+ *             The table will contain 2^log_size elements
+ */
+template<class key_t, int log_size>
+class AtomicTranspositionTable {
+ private:
+  static const size_t size = next_prime(1 << log_size); // size of the transition table. Have to be odd to be prime with 2^sizeof(key_t)
+  static constexpr int KEY_SHIFT = 16;                  // number of bits of the value
+  static constexpr int KEY_BITS = 40;                   // number of bits of the truncated key
+  static constexpr uint64_t KEY_MASK = (uint64_t(1) << KEY_BITS) - 1;
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "Entries must be lock-free to be shared between processes");
+  std::atomic<uint64_t> *T; // Array to store packed keys and values, followed by the current generation
+  const bool owner;         // true if the array was allocated by the table
+
+  // truncated key tagged with the current generation, as stored above the value
+  uint64_t tag(key_t key) const {
+    return T[size].load(std::memory_order_relaxed) << KEY_BITS | (uint64_t(key) & KEY_MASK);
+  }
+
+ public:
+  AtomicTranspositionTable() : T{new std::atomic<uint64_t>[size + 1]}, owner{true} {
+    for(size_t i = 0; i <= size; i++) T[i].store(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Build a table on an external storage of storageSize() bytes, for instance
+   * a shared memory segment. The storage is neither initialized nor released by the table,
+   * zero filled memory is an empty table.
+   */
+  explicit AtomicTranspositionTable(void *storage) : T{static_cast<std::atomic<uint64_t>*>(storage)}, owner{false} {}
+
+  ~AtomicTranspositionTable() {
+    if(owner) delete[] T;
+  }
+
+  static constexpr size_t storageSize() {
+    return (size + 1) * sizeof(std::atomic<uint64_t>);
+  }
+
+  AtomicTranspositionTable(const AtomicTranspositionTable&) = delete;
+  AtomicTranspositionTable& operator=(const AtomicTranspositionTable&) = delete;
+
+  /**
+   * Empty the Transition Table by starting a new generation, it must not be used concurrently.
+   */
+  void reset() {
+    const uint64_t generation = (T[size].load(std::memory_order_relaxed) + 1) & 0xff;
+    if(generation == 0) // the generation wrapped around, actually clear the entries
+      for(size_t i = 0; i < size; i++) T[i].store(0, std::memory_order_relaxed);
+    T[size].store(generation, std::memory_order_relaxed);
+  }
+
+  /**
+   * Store a value for a given key
+   * @param value: null (0) value is used to encode missing data
+   */
+  void put(key_t key, uint16_t value) {
+    T[key % size].store(tag(key) << KEY_SHIFT | value, std::memory_order_relaxed);
+  }
+
+  /**
+   * Get the value of a key
+   * @return value associated with the key if present, 0 otherwise.
+   */
+  uint16_t get(key_t key) const {
+    uint64_t entry = T[key % size].load(std::memory_order_relaxed);
+    if(entry >> KEY_SHIFT == tag(key)) return uint16_t(entry);
     else return 0;
   }
 };
@@ -0,0 +1,103 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Lock-free work-stealing deque of pointers (Chase-Lev algorithm).
+ *
+ * The owner thread pushes and pops items at the bottom (LIFO order), while
+ * any other thread can steal items from the top (FIFO order), that is the
+ * oldest items which are usually the largest pieces of work.
+ *
+ * The storage has a fixed capacity of 2^log_capacity items defined at compile
+ * time, pushing to a full deque fails and leaves the item to the owner.
+ */
+template<class T, int log_capacity>
+class WorkStealingDeque {
+ private:
+  static constexpr long long capacity = 1LL << log_capacity;
+  static constexpr long long mask = capacity - 1;
+
+  std::atomic<long long> top;    // index of the next item to be stolen
+  std::atomic<long long> bottom; // index of the next item to be pushed
+  std::atomic<T*> items[capacity];
+
+ public:
+  WorkStealingDeque() : top{0}, bottom{0} {}
+
+  /**
+   * Add an item at the bottom, can only be called by the owner thread.
+   * @return false if the deque is full, the item is then not added.
+   */
+  bool push(T *item) {
+    long long b = bottom.load(std::memory_order_relaxed);
+    if(b - top.load(std::memory_order_acquire) >= capacity) return false; // top only grows: never overwrites a pending item
+    items[b & mask].store(item, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release); // publish the item to thieves
+    return true;
+  }
+
+  /**
+   * Remove the last pushed item, can only be called by the owner thread.
+   * @return the item or nullptr if the deque is empty.
+   */
+  T* pop() {
+    long long b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long t = top.load(std::memory_order_relaxed);
+    T *item = nullptr;
+    if(t <= b) {
+      item = items[b & mask].load(std::memory_order_relaxed);
+      if(t == b) { // last item, race against thieves
+        if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+          item = nullptr;
+        bottom.store(b + 1, std::memory_order_relaxed);
+      }
+    } else bottom.store(b + 1, std::memory_order_relaxed); // empty deque
+    return item;
+  }
+
+  /**
+   * Remove the oldest item, can be called by any thread.
+   * @return the item or nullptr if the deque is empty or if another thread won the race.
+   */
+  T* steal() {
+    long long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long b = bottom.load(std::memory_order_acquire);
+    if(t < b) {
+      T *item = items[t & mask].load(std::memory_order_relaxed);
+      if(top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return item;
+    }
+    return nullptr;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
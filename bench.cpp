@@ -0,0 +1,243 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include "Solver.hpp"
+#include "ParallelSolver.hpp"
+#include "MultiProcessSolver.hpp"
+#include "MCTSEngine.hpp"
+#include "BookRecord.hpp"
+
+using namespace GameSolver::Connect4;
+
+/**
+ * Benchmark the solver.
+ *
+ * Reads Connect 4 positions, line by line, from standard input. Each line is a
+ * sequence of played columns optionally followed by a space and the expected score
+ * (format of the test sets Test_L*_R*). Writes one line per position to standard output:
+ *  - the position
+ *  - score of the position
+ *  - number of nodes explored
+ *  - time spent in microsecond to solve the position.
+ *  - with -a only: best column to play (1-based, 0 if none)
+ * A summary (mean time, mean number of nodes, wrong scores) is written to standard error.
+ *
+ * Options:
+ *  -w          weak solver: only compute win/draw/loss
+ *  -e engine   weak solver engine: negamax (default) or pn (proof-number search)
+ *  -k          keep the transposition table between positions
+ *  -g          use the opposite of the previous score as a guess for the next position
+ *              (MTD(f) search), mostly useful with -k on the successive positions of a game
+ *  -b file     load an opening book
+ *  -t file     load an endgame table
+ *  -j threads  use the parallel (YBWC) solver with the given number of threads
+ *  -p procs    solve the columns of each position in the given number of worker processes
+ *              sharing a transposition table in shared memory. The shared table is kept
+ *              between positions and between runs (implies -k), -R empties it first.
+ *  -R          empty the shared transposition table before solving
+ *  -a          also analyze all the moves of each position (not timed) to find the best column,
+ *              ignored with -w. With -b, book moves (OpeningBook::getMove) not reaching the best
+ *              score are counted as errors. Lines "position score best" extracted from the output
+ *              are accepted by the book generator.
+ *  -o file     also write the solved positions and their best column (implies -a) as binary
+ *              records for the book generator (see BookRecord.hpp), ignored with -w
+ *  -m ms       choose a move with the Monte-Carlo tree search engine within the given time
+ *              instead of solving, using the threads given by -j. Output lines then give the
+ *              chosen column (1-based) and the number of playouts instead of the score and
+ *              the number of nodes. Positions with an expected score are checked by solving
+ *              the position after the chosen move: moves not reaching the expected score
+ *              (its sign with -w) are counted as errors.
+ *  -n playouts same as -m with a playout budget, both limits can be combined
+ *  -r          random playouts for -m and -n, instead of avoiding moves losing at once
+ */
+int main(int argc, char** argv) {
+  bool weak = false;
+  bool keep = false;
+  bool guess = false;
+  int previousScore = 0;
+  unsigned int threads = 0;
+  unsigned int processes = 0;
+  bool resetShared = false;
+  bool bestColumn = false;
+  MCTSEngine::Limits limits{0, 0};
+  bool randomPlayouts = false;
+  std::string bookFile, endgameFile, recordFile;
+  Solver::WeakEngine engine = Solver::WeakEngine::NEGAMAX;
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-w")) weak = true;
+    else if(!strcmp(argv[i], "-k")) keep = true;
+    else if(!strcmp(argv[i], "-g")) guess = true;
+    else if(!strcmp(argv[i], "-e") && i + 1 < argc) {
+      std::string name = argv[++i];
+      if(name == "pn") engine = Solver::WeakEngine::PROOF_NUMBER;
+      else if(name != "negamax") {
+        std::cerr << "Unknown engine: " << name << std::endl;
+        return 1;
+      }
+    }
+    else if(!strcmp(argv[i], "-b") && i + 1 < argc) bookFile = argv[++i];
+    else if(!strcmp(argv[i], "-t") && i + 1 < argc) endgameFile = argv[++i];
+    else if(!strcmp(argv[i], "-j") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-p") && i + 1 < argc) processes = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-R")) resetShared = true;
+    else if(!strcmp(argv[i], "-a")) bestColumn = true;
+    else if(!strcmp(argv[i], "-o") && i + 1 < argc) {
+      recordFile = argv[++i];
+      bestColumn = true;
+    }
+    else if(!strcmp(argv[i], "-m") && i + 1 < argc) limits.milliseconds = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-n") && i + 1 < argc) limits.playouts = strtoull(argv[++i], nullptr, 10);
+    else if(!strcmp(argv[i], "-r")) randomPlayouts = true;
+    else {
+      std::cerr << "usage: " << argv[0] << " [-w] [-e negamax|pn] [-k] [-g] [-b book] [-t endgame_table] [-j threads] [-p processes [-R]] [-a] [-o records] [-m ms] [-n playouts] [-r] < positions" << std::endl;
+      return 1;
+    }
+  }
+
+  Solver solver;
+  std::unique_ptr<ParallelSolver> parallel;
+  std::unique_ptr<MultiProcessSolver> multi;
+  std::unique_ptr<MCTSEngine> mcts;
+  if(limits.milliseconds || limits.playouts) {
+    mcts.reset(new MCTSEngine(threads ? threads : 1, randomPlayouts ? MCTSEngine::Playout::RANDOM : MCTSEngine::Playout::HEURISTIC));
+    threads = processes = 0; // positions are only solved to check the chosen moves
+  }
+  else if(threads) parallel.reset(new ParallelSolver(threads));
+  if(processes) {
+    multi.reset(new MultiProcessSolver(processes));
+    if(resetShared) multi->reset();
+    keep = true;
+  }
+  if(!bookFile.empty()) {
+    solver.loadBook(bookFile);
+    if(parallel) parallel->loadBook(bookFile);
+    if(multi) multi->loadBook(bookFile);
+  }
+  if(!endgameFile.empty()) {
+    solver.loadEndgameTable(endgameFile);
+    if(parallel) parallel->loadEndgameTable(endgameFile);
+    if(multi) multi->loadEndgameTable(endgameFile);
+  }
+
+  std::unique_ptr<BookRecordWriter> records;
+  if(!recordFile.empty() && !weak) records.reset(new BookRecordWriter(recordFile));
+
+  long long count = 0, errors = 0, bookMoves = 0;
+  unsigned long long totalNodes = 0;
+  double totalTime = 0;
+  std::string line;
+  for(int l = 1; std::getline(std::cin, line); l++) {
+    std::istringstream iss(line);
+    std::string moves;
+    int expected;
+    iss >> moves;
+    bool check = bool(iss >> expected);
+
+    Position P;
+    if(P.play(moves) != moves.size()) {
+      std::cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << moves << "\"" << std::endl;
+      std::cout << std::endl;
+      continue;
+    }
+    if(!keep) {
+      if(parallel) parallel->reset();
+      else solver.reset();
+    }
+    if(mcts) {
+      unsigned long long previousPlayouts = mcts->getPlayoutCount();
+      auto start = std::chrono::steady_clock::now();
+      int column = mcts->bestMove(P, limits);
+      double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+      unsigned long long playouts = mcts->getPlayoutCount() - previousPlayouts;
+
+      if(check && column >= 0) {
+        int score;
+        if(P.isWinningMove(column)) score = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+        else {
+          Position P2(P);
+          P2.playCol(column);
+          score = -solver.solve(P2, weak, engine);
+        }
+        if(weak ? (score > 0) - (score < 0) != (expected > 0) - (expected < 0) : score != expected) {
+          std::cerr << "Line " << l << ": column " << (column + 1) << " scores " << score << " (expected " << expected << ")" << std::endl;
+          errors++;
+        }
+      }
+      count++;
+      totalNodes += playouts;
+      totalTime += time;
+      std::cout << moves << " " << (column + 1) << " " << playouts << " " << time << std::endl;
+      continue;
+    }
+    unsigned long long previousNodes = multi ? multi->getNodeCount() : parallel ? parallel->getNodeCount() : solver.getNodeCount();
+    auto start = std::chrono::steady_clock::now();
+    int score;
+    if(multi) score = multi->solve(P, weak);
+    else if(parallel) score = parallel->solve(P, weak);
+    else if(guess && !weak) score = solver.solveWithGuess(P, -previousScore);
+    else score = solver.solve(P, weak, engine);
+    previousScore = score;
+    double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    unsigned long long nodes = (multi ? multi->getNodeCount() : parallel ? parallel->getNodeCount() : solver.getNodeCount()) - previousNodes;
+
+    if(check && (weak ? (score > 0) - (score < 0) != (expected > 0) - (expected < 0) : score != expected)) {
+      std::cerr << "Line " << l << ": wrong score " << score << " (expected " << expected << ")" << std::endl;
+      errors++;
+    }
+    int best = -1;
+    if(bestColumn && !weak) {
+      std::vector<int> scores = multi ? multi->analyze(P) : parallel ? parallel->analyze(P) : solver.analyze(P);
+      best = Solver::bestColumn(scores);
+      int bookMove = solver.bookMove(P);
+      if(bookMove >= 0) {
+        bookMoves++;
+        if(scores[bookMove] != scores[best]) {
+          std::cerr << "Line " << l << ": book move " << (bookMove + 1) << " scores " << scores[bookMove]
+                    << " (best " << scores[best] << ")" << std::endl;
+          errors++;
+        }
+      }
+    }
+    if(records && !records->write(P, score, best))
+      std::cerr << "Line " << l << ": position too deep for a binary record" << std::endl;
+    count++;
+    totalNodes += nodes;
+    totalTime += time;
+    std::cout << moves << " " << score << " " << nodes << " " << time;
+    if(bestColumn && !weak) std::cout << " " << (best + 1);
+    std::cout << std::endl;
+  }
+
+  if(count && mcts) std::cerr << count << " positions, mean time: " << totalTime / count << " us, mean playouts: "
+                              << double(totalNodes) / count << ", K playouts/s: " << totalNodes / totalTime * 1000
+                              << ", errors: " << errors << std::endl;
+  else if(count) std::cerr << count << " positions, mean time: " << totalTime / count << " us, mean nb pos: "
+                           << double(totalNodes) / count << ", K pos/s: " << totalNodes / totalTime * 1000
+                           << ", errors: " << errors << std::endl;
+  if(bookMoves) std::cerr << bookMoves << " book moves checked" << std::endl;
+  if(records && !records->ok()) {
+    std::cerr << "Unable to write binary records: " << recordFile << std::endl;
+    return 1;
+  }
+  return errors != 0;
+}
@@ -0,0 +1,577 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Solver.hpp"
+#include "ResultCache.hpp"
+
+using namespace GameSolver::Connect4;
+
+/**
+ * c4d: long running solver daemon.
+ *
+ * Clients connect to a UNIX domain socket (or a localhost TCP port) and send
+ * one request per line, the daemon answers each request in order, with one line
+ * unless stated otherwise:
+ *   solve <moves>     -> score of the position
+ *   analyze <moves>   -> score of each column, "-" for unplayable columns
+ *   bestmove <moves>  -> best column to play (1-based)
+ *   game <moves>      -> one "column:played/best" item per move of a game, the played
+ *                        and best scores of the position, marked with "!" for blunders
+ *   stream <moves>    -> two lines: "weak" followed by the sign of the score of each
+ *                        column, sent as soon as known, then "exact" followed by the
+ *                        scores of each column as answered by analyze
+ *   stats             -> hits, misses and hit rate of the result cache
+ * <moves> is a sequence of played columns as accepted by Position::play, it can
+ * be omitted for the empty board. Errors are answered with "error <reason>".
+ *
+ * A single thread runs an epoll event loop for all the connections and queues
+ * the requests. A pool of worker threads, each one with its own warm Solver
+ * (opening book loaded once, transposition table kept between requests),
+ * takes the queued requests by small batches and hands each answer back to the
+ * event loop through an eventfd. Final results are kept in a ResultCache
+ * shared by all the workers, so that repeated and mirrored queries are answered
+ * without searching.
+ */
+
+namespace {
+
+constexpr size_t BATCH_SIZE = 16;        // max number of requests taken at once by a worker
+constexpr size_t MAX_LINE_LENGTH = 4096; // connections sending longer lines are closed
+constexpr uint64_t LISTEN_ID = 0;        // epoll identifier of the listening socket
+constexpr uint64_t EVENT_ID = 1;         // epoll identifier of the eventfd
+constexpr int MAX_EVENTS = 64;
+
+volatile sig_atomic_t stopRequested = 0;
+
+struct Request {
+  uint64_t conn; // connection identifier
+  uint64_t seq;  // index of the request in its connection
+  std::string line;
+};
+
+struct Response {
+  uint64_t conn;
+  uint64_t seq;
+  std::string text;
+  bool last = true; // false for the partial answers of a streamed request
+};
+
+/**
+ * Requests waiting for a worker.
+ */
+class RequestQueue {
+  std::mutex mutex;
+  std::condition_variable available;
+  std::deque<Request> requests;
+  bool closed = false;
+  const size_t nbWorkers;
+
+ public:
+  explicit RequestQueue(size_t nbWorkers) : nbWorkers{nbWorkers} {}
+
+  void push(std::vector<Request> &batch) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for(auto &r : batch) requests.push_back(std::move(r));
+    }
+    if(batch.size() > 1) available.notify_all();
+    else available.notify_one();
+    batch.clear();
+  }
+
+  /**
+   * Wait for requests and take up to max of them, returns false once the queue is closed.
+   * A worker takes no more than its share of the queued requests, so that the other
+   * workers are not left idle while it runs them one after another.
+   */
+  bool pop(std::vector<Request> &batch, size_t max) {
+    std::unique_lock<std::mutex> lock(mutex);
+    available.wait(lock, [this] {return closed || !requests.empty();});
+    if(closed) return false;
+    max = std::min(max, std::max<size_t>(1, requests.size() / nbWorkers));
+    while(!requests.empty() && batch.size() < max) {
+      batch.push_back(std::move(requests.front()));
+      requests.pop_front();
+    }
+    return true;
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closed = true;
+    }
+    available.notify_all();
+  }
+};
+
+/**
+ * Answers computed by the workers, waiting for the event loop.
+ */
+class ResponseQueue {
+  std::mutex mutex;
+  std::vector<Response> responses;
+  int eventFd;
+
+ public:
+  explicit ResponseQueue(int eventFd) : eventFd{eventFd} {}
+
+  void push(std::vector<Response> &batch) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for(auto &r : batch) responses.push_back(std::move(r));
+    }
+    batch.clear();
+    uint64_t one = 1;
+    if(write(eventFd, &one, sizeof(one)) < 0) {} // wake up the event loop, failure means it is already signaled
+  }
+
+  void take(std::vector<Response> &batch) {
+    std::lock_guard<std::mutex> lock(mutex);
+    batch.swap(responses);
+  }
+};
+
+struct Connection {
+  int fd;
+  std::string in;       // received data not parsed yet
+  std::string out;      // answers not sent yet
+  uint64_t nextSeq = 0; // index of the next request
+  uint64_t nextSend = 0; // index of the next answer to send
+  std::map<uint64_t, std::pair<std::string, bool>> ready; // answer lines not sent yet and whether the answer is complete
+  bool writing = false; // EPOLLOUT is enabled
+  bool eof = false;     // the client shut down its side, the connection is closed once all its answers are sent
+};
+
+std::string formatScore(int score) {
+  return score == Solver::INVALID_MOVE ? "-" : std::to_string(score);
+}
+
+/**
+ * Scores of all the columns of a position, as Solver::analyze.
+ * @param cache: optional cache of final results, looked up first and filled with the computed scores.
+ */
+std::vector<int> analyze(Solver &solver, ResultCache *cache, const Position &P) {
+  std::vector<int> scores;
+  if(cache && cache->getAnalysis(P, false, scores)) return scores;
+  scores = solver.analyze(P);
+  if(cache) cache->putAnalysis(P, false, scores);
+  return scores;
+}
+
+std::string formatScores(const std::vector<int> &scores) {
+  std::string result;
+  for(int score : scores) {
+    if(!result.empty()) result += ' ';
+    result += formatScore(score);
+  }
+  return result;
+}
+
+/**
+ * Compute the answer to a request line.
+ * @param cache: optional cache of final results.
+ * @param partial: sends the first lines of a multi-line answer, the returned text is the last line.
+ */
+std::string handle(Solver &solver, ResultCache *cache, const std::string &line,
+                   const std::function<void(const std::string&)> &partial) {
+  std::istringstream iss(line);
+  std::string command, moves, extra;
+  iss >> command >> moves >> extra;
+  if(!extra.empty()) return "error too many arguments";
+  if(command == "game") { // a game record may end with a winning move, invalid moves end the analysis
+    std::string result;
+    for(const Solver::MoveAnalysis &m : solver.analyzeGame(moves)) {
+      int best = Solver::INVALID_MOVE;
+      for(int score : m.scores) if(score > best) best = score;
+      if(!result.empty()) result += ' ';
+      result += std::to_string(m.column + 1) + ':' + formatScore(m.scores[m.column]) + '/' + formatScore(best);
+      if(m.blunder) result += '!';
+    }
+    return result;
+  }
+  Position P;
+  if(P.play(moves) != moves.size()) return "error invalid move " + std::to_string(P.nbMoves() + 1);
+
+  if(command == "solve") {
+    int score;
+    if(cache && cache->getScore(P, false, score)) return formatScore(score);
+    score = solver.solve(P);
+    if(cache) cache->putScore(P, false, score);
+    return formatScore(score);
+  }
+  if(command == "analyze") return formatScores(analyze(solver, cache, P));
+  if(command == "stream") {
+    std::vector<int> scores;
+    if(!cache || !cache->getAnalysis(P, false, scores)) {
+      std::vector<int> weak(Position::WIDTH, Solver::INVALID_MOVE);
+      int remaining = 0; // playable columns not weakly solved yet
+      for(int col = 0; col < Position::WIDTH; col++) remaining += P.canPlay(col);
+      if(remaining == 0) partial("weak " + formatScores(weak));
+      scores = solver.analyzeProgressive(P, [&](int column, int score, bool) {
+        if(weak[column] != Solver::INVALID_MOVE) return; // exact refinement, sent with the last line
+        weak[column] = (score > 0) - (score < 0);
+        if(--remaining == 0) partial("weak " + formatScores(weak));
+      });
+      if(cache) cache->putAnalysis(P, false, scores);
+    } else {
+      std::vector<int> weak(scores);
+      for(int &score : weak) if(score != Solver::INVALID_MOVE) score = (score > 0) - (score < 0);
+      partial("weak " + formatScores(weak));
+    }
+    return "exact " + formatScores(scores);
+  }
+  if(command == "bestmove") {
+    int best = solver.bookMove(P); // instant in book depth
+    if(best >= 0) return std::to_string(best + 1);
+    best = Solver::bestColumn(analyze(solver, cache, P));
+    return best < 0 ? "error no possible move" : std::to_string(best + 1);
+  }
+  if(command == "stats") {
+    if(!cache) return "error no cache";
+    std::ostringstream oss;
+    oss << "hits " << cache->getHits() << " misses " << cache->getMisses() << " rate " << cache->hitRate();
+    return oss.str();
+  }
+  return "error unknown command " + command;
+}
+
+void workerLoop(RequestQueue &requests, ResponseQueue &responses, ResultCache *cache,
+                const std::string &bookFile, const std::string &endgameFile) {
+  Solver solver;
+  if(!bookFile.empty()) solver.loadBook(bookFile);
+  if(!endgameFile.empty()) solver.loadEndgameTable(endgameFile);
+  std::vector<Request> batch;
+  std::vector<Response> answers;
+  while(requests.pop(batch, BATCH_SIZE)) {
+    for(const Request &r : batch) {
+      auto partial = [&](const std::string &text) { // streamed lines are sent right away
+        answers.push_back(Response{r.conn, r.seq, text, false});
+        responses.push(answers);
+      };
+      answers.push_back(Response{r.conn, r.seq, handle(solver, cache, r.line, partial)});
+      responses.push(answers); // sent without waiting for the rest of the batch
+    }
+    batch.clear();
+  }
+}
+
+bool setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+int listenUnix(const std::string &path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0) return -1;
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if(path.size() >= sizeof(addr.sun_path)) {
+    close(fd);
+    return -1;
+  }
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str()); // remove a stale socket of a previous run
+  if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int listenTcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if(fd < 0) return -1;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * Event loop serving all the connections.
+ */
+class Server {
+  int epollFd;
+  int listenFd;
+  int eventFd;
+  RequestQueue &requests;
+  ResponseQueue &responses;
+  std::unordered_map<uint64_t, Connection> connections;
+  uint64_t nextId = EVENT_ID + 1;
+  std::vector<Request> pending; // requests parsed during the current loop iteration
+
+  void watch(uint64_t id, int fd, uint32_t events, int op) {
+    epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = id;
+    epoll_ctl(epollFd, op, fd, &ev);
+  }
+
+  void closeConnection(uint64_t id) {
+    auto it = connections.find(id);
+    if(it == connections.end()) return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    connections.erase(it); // answers still computed for this connection will be dropped
+  }
+
+  /**
+   * Updates the events watched on a connection: input until the client shuts down its side,
+   * output while answers are waiting to be sent.
+   */
+  void watch(uint64_t id, const Connection &c) {
+    watch(id, c.fd, (c.eof ? 0 : uint32_t(EPOLLIN | EPOLLRDHUP)) | (c.writing ? uint32_t(EPOLLOUT) : 0), EPOLL_CTL_MOD);
+  }
+
+  /**
+   * Closes a connection whose client shut down its side once every answer has been sent.
+   * @return true if the connection was closed.
+   */
+  bool closeIfDone(uint64_t id, const Connection &c) {
+    if(!c.eof || c.nextSend != c.nextSeq || !c.out.empty()) return false;
+    closeConnection(id);
+    return true;
+  }
+
+  void accept() {
+    while(true) {
+      int fd = ::accept(listenFd, nullptr, nullptr);
+      if(fd < 0) return;
+      if(!setNonBlocking(fd)) {
+        close(fd);
+        continue;
+      }
+      uint64_t id = nextId++;
+      connections[id].fd = fd;
+      watch(id, fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+    }
+  }
+
+  void flush(uint64_t id, Connection &c) {
+    while(!c.out.empty()) {
+      ssize_t n = write(c.fd, c.out.data(), c.out.size());
+      if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if(n <= 0) {
+        closeConnection(id);
+        return;
+      }
+      c.out.erase(0, n);
+    }
+    if(closeIfDone(id, c)) return;
+    bool writing = !c.out.empty();
+    if(writing != c.writing) {
+      c.writing = writing;
+      watch(id, c);
+    }
+  }
+
+  void receive(uint64_t id, Connection &c) {
+    char buffer[4096];
+    while(true) {
+      ssize_t n = read(c.fd, buffer, sizeof(buffer));
+      if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if(n == 0) { // the client shut down its side, it may still be waiting for the answers
+        c.eof = true;
+        break;
+      }
+      if(n < 0) {
+        closeConnection(id);
+        return;
+      }
+      c.in.append(buffer, n);
+    }
+    if(c.eof && !c.in.empty() && c.in.back() != '\n') c.in += '\n'; // the last line may not be terminated
+    size_t start = 0;
+    for(size_t end; (end = c.in.find('\n', start)) != std::string::npos; start = end + 1) {
+      std::string line = c.in.substr(start, end - start);
+      if(!line.empty() && line.back() == '\r') line.pop_back();
+      if(!line.empty()) pending.push_back(Request{id, c.nextSeq++, std::move(line)});
+    }
+    c.in.erase(0, start);
+    if(c.in.size() > MAX_LINE_LENGTH) closeConnection(id);
+    else if(c.eof && !closeIfDone(id, c)) watch(id, c); // stop watching the input
+  }
+
+  void deliver() {
+    uint64_t counter;
+    if(read(eventFd, &counter, sizeof(counter)) < 0) {} // reset the eventfd counter
+    std::vector<Response> answers;
+    responses.take(answers);
+    for(Response &r : answers) {
+      auto it = connections.find(r.conn);
+      if(it == connections.end()) continue; // connection closed meanwhile
+      Connection &c = it->second;
+      auto &answer = c.ready[r.seq];
+      answer.first += r.text;
+      answer.first += '\n';
+      answer.second = r.last;
+      for(auto next = c.ready.begin(); next != c.ready.end() && next->first == c.nextSend;) { // send answers in order
+        c.out += next->second.first;
+        next->second.first.clear();
+        if(!next->second.second) break; // the rest of this answer is still being computed
+        next = c.ready.erase(next);
+        c.nextSend++;
+      }
+    }
+    for(auto it = connections.begin(); it != connections.end();) { // flush may close and erase the connection
+      uint64_t id = it->first;
+      Connection &c = it->second;
+      ++it;
+      if(!c.writing && (!c.out.empty() || c.eof)) flush(id, c);
+    }
+  }
+
+ public:
+  Server(int listenFd, int eventFd, RequestQueue &requests, ResponseQueue &responses) :
+    epollFd{epoll_create1(0)}, listenFd{listenFd}, eventFd{eventFd}, requests{requests}, responses{responses} {
+    watch(LISTEN_ID, listenFd, EPOLLIN, EPOLL_CTL_ADD);
+    watch(EVENT_ID, eventFd, EPOLLIN, EPOLL_CTL_ADD);
+  }
+
+  ~Server() {
+    for(auto &c : connections) close(c.second.fd);
+    close(epollFd);
+  }
+
+  void run() {
+    epoll_event events[MAX_EVENTS];
+    while(!stopRequested) {
+      int n = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+      if(n < 0) {
+        if(errno == EINTR) continue;
+        std::cerr << "epoll_wait failed: " << strerror(errno) << std::endl;
+        return;
+      }
+      for(int i = 0; i < n; i++) {
+        uint64_t id = events[i].data.u64;
+        if(id == LISTEN_ID) accept();
+        else if(id == EVENT_ID) deliver();
+        else {
+          auto it = connections.find(id);
+          if(it == connections.end()) continue;
+          if(events[i].events & EPOLLOUT) flush(id, it->second);
+          it = connections.find(id);
+          if(it == connections.end()) continue;
+          if(it->second.eof) { // input already closed: only a failure of the socket is left to handle
+            if(events[i].events & (EPOLLHUP | EPOLLERR)) closeConnection(id);
+          }
+          else if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            receive(id, it->second);
+        }
+      }
+      if(!pending.empty()) requests.push(pending); // one queue operation for all the requests of this iteration
+    }
+  }
+};
+
+void onSignal(int) {
+  stopRequested = 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string socketPath = "/tmp/c4d.sock";
+  int port = 0;
+  unsigned int nbWorkers = std::thread::hardware_concurrency();
+  size_t cacheSize = 1 << 20;
+  std::string bookFile, endgameFile;
+
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-s") && i + 1 < argc) socketPath = argv[++i];
+    else if(!strcmp(argv[i], "-p") && i + 1 < argc) port = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-j") && i + 1 < argc) nbWorkers = atoi(argv[++i]);
+    else if(!strcmp(argv[i], "-b") && i + 1 < argc) bookFile = argv[++i];
+    else if(!strcmp(argv[i], "-t") && i + 1 < argc) endgameFile = argv[++i];
+    else if(!strcmp(argv[i], "-c") && i + 1 < argc) cacheSize = strtoull(argv[++i], nullptr, 10);
+    else {
+      std::cerr << "usage: " << argv[0] << " [-s socket_path | -p tcp_port] [-j workers] [-b book] [-t endgame_table] [-c cache_entries]" << std::endl;
+      return 1;
+    }
+  }
+  if(nbWorkers < 1) nbWorkers = 1;
+
+  int listenFd = port ? listenTcp(port) : listenUnix(socketPath);
+  int eventFd = eventfd(0, EFD_NONBLOCK);
+  if(listenFd < 0 || eventFd < 0 || !setNonBlocking(listenFd)) {
+    std::cerr << "Unable to listen on " << (port ? "port " + std::to_string(port) : socketPath) << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSignal; // no SA_RESTART: interrupt epoll_wait
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+
+  std::unique_ptr<ResultCache> cache(cacheSize ? new ResultCache(cacheSize) : nullptr); // -c 0 disables the cache
+  RequestQueue requests(nbWorkers);
+  ResponseQueue responses(eventFd);
+  std::vector<std::thread> workers;
+  for(unsigned int i = 0; i < nbWorkers; i++)
+    workers.emplace_back(workerLoop, std::ref(requests), std::ref(responses), cache.get(), bookFile, endgameFile);
+
+  std::cerr << "c4d listening on " << (port ? "127.0.0.1:" + std::to_string(port) : socketPath)
+            << " with " << nbWorkers << " workers" << std::endl;
+  {
+    Server server(listenFd, eventFd, requests, responses);
+    server.run();
+  }
+
+  requests.close(); // workers finish their current batch
+  for(auto &t : workers) t.join();
+  close(listenFd);
+  close(eventFd);
+  if(!port) unlink(socketPath.c_str());
+  return 0;
+}
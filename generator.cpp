@@ -1,87 +1,493 @@
 #include "Position.hpp"
 #include "OpeningBook.hpp"
+#include "Solver.hpp"
+#include "SortedRuns.hpp"
+#include "BookRecord.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 #include <string>
-#include <unordered_set>
+#include <unordered_map>
+#include <thread>
+#include <vector>
+#include <unistd.h>
 
 using namespace GameSolver::Connect4;
 
-std::unordered_set<uint64_t> visited;
+/**
+ * Enumeration of all the positions up to a given depth, symetric positions being listed only once.
+ *
+ * Positions are enumerated ply by ply: the frontier of a ply is the sorted set of its unique
+ * positions, each one stored as its key3() and its sequence of moves. The children of a frontier
+ * are generated by a pool of threads into sorted runs spilled to disk once a memory buffer is full,
+ * then the runs are merged into the next frontier, removing duplicates. Frontiers and runs are
+ * split into one shard per thread according to the key, so that all the steps run in parallel and
+ * only the buffers are held in memory.
+ */
+class Enumerator {
+  static constexpr int MOVE_BITS = 3; // a move is packed in the data of a record on MOVE_BITS bits
+
+  const int depth;
+  const int nb_shards;
+  const std::string tmp_prefix; // prefix of the temporary files
+  const size_t buffer_size;     // max number of records held in memory by each thread
+  std::vector<int> nb_runs;     // number of runs written by each thread for the current ply
+  std::atomic<bool> failed;
+
+  std::string file(const char *kind, int ply, int shard) const {
+    return tmp_prefix + kind + "-" + std::to_string(ply) + "-" + std::to_string(shard);
+  }
+
+  std::string runFile(int ply, int shard, int thread, int run) const {
+    return file("run", ply, shard) + "-" + std::to_string(thread) + "-" + std::to_string(run);
+  }
+
+  int shardOf(uint64_t key) const {
+    return key % nb_shards;
+  }
+
+  static Position replay(uint64_t moves, int nb_moves) {
+    Position P;
+    for(int i = 0; i < nb_moves; i++) P.playCol(moves >> (MOVE_BITS * i) & ((1 << MOVE_BITS) - 1));
+    return P;
+  }
+
+  // Sort and deduplicate the buffer, then write it as one run per destination shard
+  void flush(std::vector<Record> &buffer, int ply, int thread) {
+    std::sort(buffer.begin(), buffer.end());
+    std::vector<std::unique_ptr<RunWriter>> writers;
+    for(int shard = 0; shard < nb_shards; shard++) {
+      writers.emplace_back(new RunWriter(runFile(ply, shard, thread, nb_runs[thread])));
+      if(!writers.back()->ok()) failed = true;
+    }
+    for(size_t i = 0; i < buffer.size() && !failed; i++)
+      if(i == 0 || buffer[i].key != buffer[i - 1].key) writers[shardOf(buffer[i].key)]->write(buffer[i]);
+    for(auto &w : writers) if(!w->close()) failed = true;
+    nb_runs[thread]++;
+    buffer.clear();
+  }
+
+  // Generate the children of the positions of a shard of the frontier of ply - 1
+  void expand(int ply, int thread) {
+    std::vector<Record> buffer;
+    buffer.reserve(buffer_size);
+    RunReader frontier(file("frontier", ply - 1, thread));
+    for(Record r; frontier.read(r);) {
+      const Position P = replay(r.data, ply - 1);
+      for(int i = 0; i < Position::WIDTH; i++) // explore all possible moves
+        if(P.canPlay(i) && !P.isWinningMove(i)) {
+          Position P2(P);
+          P2.playCol(i);
+          buffer.push_back(Record{P2.key3(), r.data | uint64_t(i) << (MOVE_BITS * (ply - 1))});
+          if(buffer.size() == buffer_size) flush(buffer, ply, thread);
+        }
+    }
+    flush(buffer, ply, thread);
+  }
+
+  // Merge the runs of a shard into the frontier of ply, and print its positions in a text file
+  // @return the number of positions of the shard
+  uint64_t merge(int ply, int shard) {
+    std::vector<std::string> runs;
+    for(int thread = 0; thread < nb_shards; thread++)
+      for(int run = 0; run < nb_runs[thread]; run++) runs.push_back(runFile(ply, shard, thread, run));
+    RunWriter frontier(file("frontier", ply, shard));
+    FILE *text = fopen(file("text", ply, shard).c_str(), "w");
+    uint64_t count = 0;
+    if(!frontier.ok() || !text || !mergeRuns(runs, [&](const Record &r) {
+      count++;
+      if(ply < depth) frontier.write(r); // the last frontier is not expanded
+      char pos_str[MAX_DEPTH + 2];
+      for(int i = 0; i < ply; i++) pos_str[i] = '1' + (r.data >> (MOVE_BITS * i) & ((1 << MOVE_BITS) - 1));
+      pos_str[ply] = '\n';
+      fwrite(pos_str, 1, ply + 1, text);
+    })) failed = true;
+    if(!frontier.close() || !text || ferror(text)) failed = true;
+    if(text) fclose(text);
+    for(const std::string &run : runs) std::remove(run.c_str());
+    return count;
+  }
+
+  // Copy a text file to the standard output and remove it
+  void print(const std::string &filename) {
+    std::cout.flush();
+    FILE *text = fopen(filename.c_str(), "r");
+    char buffer[1 << 16];
+    for(size_t n; text && (n = fread(buffer, 1, sizeof(buffer), text)) > 0;) fwrite(buffer, 1, n, stdout);
+    if(text) fclose(text);
+    fflush(stdout);
+    std::remove(filename.c_str());
+  }
+
+  template<class F>
+  void parallel(F f) {
+    std::vector<std::thread> threads;
+    for(int i = 0; i < nb_shards; i++) threads.emplace_back(f, i);
+    for(std::thread &t : threads) t.join();
+  }
+
+ public:
+  static constexpr int MAX_DEPTH = 64 / MOVE_BITS; // the moves of a position have to fit in 64 bits
+
+  /**
+   * @param nb_threads: number of threads and of shards.
+   * @param tmp_dir: directory of the temporary files.
+   * @param memory_mb: total memory used by the buffers, in MB.
+   */
+  Enumerator(int depth, int nb_threads, const std::string &tmp_dir, size_t memory_mb) :
+    depth{depth}, nb_shards{nb_threads},
+    tmp_prefix{tmp_dir + "/c4generator-" + std::to_string(getpid()) + "-"},
+    buffer_size{std::max<size_t>(1024, (memory_mb << 20) / sizeof(Record) / nb_threads)},
+    nb_runs(nb_threads), failed{false} {}
+
+  /**
+   * Print all the positions up to depth, ply by ply.
+   * @return false in case of failure with the temporary files.
+   */
+  bool run() {
+    std::cout << std::endl; // empty position
+    {
+      RunWriter root(file("frontier", 0, shardOf(Position().key3())));
+      root.write(Record{Position().key3(), 0});
+      for(int shard = 0; shard < nb_shards; shard++) RunWriter(file("frontier", 0, shard)).close(); // create missing shards
+    }
+    for(int ply = 1; ply <= depth && !failed; ply++) {
+      std::fill(nb_runs.begin(), nb_runs.end(), 0);
+      parallel([&](int thread) {expand(ply, thread);});
+      std::vector<uint64_t> counts(nb_shards);
+      parallel([&](int shard) {counts[shard] = merge(ply, shard);});
+      for(int shard = 0; shard < nb_shards; shard++) {
+        std::remove(file("frontier", ply - 1, shard).c_str());
+        print(file("text", ply, shard));
+      }
+      uint64_t count = 0;
+      for(uint64_t c : counts) count += c;
+      std::cerr << "depth " << ply << ": " << count << " positions" << std::endl;
+    }
+    for(int shard = 0; shard < nb_shards; shard++) std::remove(file("frontier", depth, shard).c_str());
+    return !failed;
+  }
+};
 
 /**
- * Explore and print all possible position under a given depth.
- * symetric positions are printed only once.
+ * Parse a line of scored position: a valid position (possibly empty string), a space and a valid score,
+ * optionally followed by a space and the best column to play (1-based).
+ * @param move: set to the best column to play (1-based) in the orientation of key3(), 0 if not given.
+ * @return false if the line is invalid.
  */
-void explore(const Position &P, char* pos_str, const int depth) {
-  uint64_t key = P.key3();
-  if(!visited.insert(key).second)
-    return; // already explored position
-
-  int nb_moves = P.nbMoves();
-  if(nb_moves <= depth)
-  std::cout << pos_str << std::endl;
-  if(nb_moves >= depth) return;  // do not explore at further depth
-
-  for(int i = 0; i < Position::WIDTH; i++) // explore all possible moves
-    if(P.canPlay(i) && !P.isWinningMove(i)) {
-      Position P2(P);
-      P2.playCol(i);
-      pos_str[nb_moves] = '1' + i;
-      explore(P2, pos_str, depth);
-      pos_str[nb_moves] = 0;
+bool parse_line(const std::string &line, Position &P, int &score, int &move) {
+  std::istringstream iss(line);
+  std::string pos;
+  getline(iss, pos, ' '); // read position before first space character
+  move = 0;
+  iss >> score;
+  if(!iss.fail() && !iss.eof()) iss >> move;
+
+  if(iss.fail() || !iss.eof()
+      || P.play(pos) != pos.length()
+      || score < Position::MIN_SCORE || score > Position::MAX_SCORE
+      || move < 0 || move > Position::WIDTH || (move && !P.canPlay(move - 1))) return false;
+  if(move && P.isKey3Mirrored()) move = Position::WIDTH + 1 - move; // stored in the orientation of the key
+  return true;
+}
+
+/**
+ * Store binary records (see BookRecord.hpp) in a book table and its best moves.
+ *
+ * Files are memory mapped and read by batches of BATCH_SIZE records. Each thread first decodes
+ * and checks its own contiguous chunk of the batch, and dispatches the valid records to the
+ * thread owning their slots of the table. Each thread then stores the records of its slots,
+ * taking them chunk after chunk, so that records are stored in file order for each slot
+ * (the last one wins on collisions, as with sequential puts) without any locking.
+ * @return the number of stored records, or -1 if a file cannot be read.
+ */
+template<class table_t>
+long long ingest_records(const std::vector<std::string> &files, table_t *table, uint8_t *moves, size_t size, int depth, bool &has_moves) {
+  static constexpr size_t BATCH_SIZE = 1 << 24; // records dispatched at once, 128MB
+  const unsigned nb_threads = std::max(1u, std::thread::hardware_concurrency());
+  auto run = [nb_threads](auto task) { // run task(t) on every thread t and wait for them
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < nb_threads; t++) threads.emplace_back(task, t);
+    for(std::thread &thread : threads) thread.join();
+  };
+  std::vector<std::vector<std::vector<uint64_t>>> dispatched(nb_threads, std::vector<std::vector<uint64_t>>(nb_threads)); // [chunk][owner]
+  long long stored = 0;
+  for(const std::string &filename : files) {
+    BookRecordFile records;
+    if(!records.open(filename)) {
+      std::cerr << "Unable to read binary records: " << filename << std::endl;
+      return -1;
     }
+    std::vector<long long> valid(nb_threads), invalid(nb_threads);
+    std::vector<char> found_moves(nb_threads);
+    for(size_t batch = 0; batch < records.size(); batch += BATCH_SIZE) {
+      const size_t batch_size = std::min(BATCH_SIZE, records.size() - batch);
+      run([&](unsigned t) {
+        const uint64_t *data = records.data() + batch;
+        for(std::vector<uint64_t> &owned : dispatched[t]) owned.clear();
+        for(size_t i = batch_size * t / nb_threads, end = batch_size * (t + 1) / nb_threads; i < end; i++) {
+          const uint64_t r = data[i];
+          const int value = BookRecord::value(r);
+          const int move = BookRecord::move(r);
+          if(BookRecord::nbMoves(r) > depth || value < 1 || value > Position::MAX_SCORE - Position::MIN_SCORE + 1 || move > Position::WIDTH) {
+            invalid[t]++;
+            continue;
+          }
+          dispatched[t][BookRecord::key(r) % size % nb_threads].push_back(r); // the table index is key % size
+          found_moves[t] |= move != 0;
+          valid[t]++;
+        }
+      });
+      run([&](unsigned t) {
+        for(unsigned chunk = 0; chunk < nb_threads; chunk++)
+          for(uint64_t r : dispatched[chunk][t]) {
+            const uint64_t key = BookRecord::key(r);
+            table->put(key, BookRecord::value(r));
+            moves[table->locate(key)] = BookRecord::move(r); // also clears the move of an overwritten entry
+          }
+      });
+    }
+    long long nb_invalid = 0;
+    for(unsigned t = 0; t < nb_threads; t++) {
+      stored += valid[t];
+      nb_invalid += invalid[t];
+      has_moves |= found_moves[t];
+    }
+    if(nb_invalid) std::cerr << nb_invalid << " invalid records ignored in " << filename << std::endl;
+  }
+  return stored;
 }
 
 /**
- * Read scored positions from stdin and store them in an opening book
+ * Read scored positions and store them in an opening book
  *
- * Input lines must be a valid position (possibly empty string), a space and a valid score
- * Read input until EOF or an empty line is reached.
+ * Without record files, input lines are read from stdin until EOF or an empty line
+ * is reached and parsed by parse_line(). Binary record files are faster to read.
+ * Best moves are saved in the book only if at least one position provides one.
+ * @param record_files: binary record files (see BookRecord.hpp) to read instead of stdin.
  */
-void generate_opening_book() {
+int generate_opening_book(const std::vector<std::string> &record_files) {
   static constexpr int BOOK_SIZE = 23; // store 2^BOOK_SIZE positions in the book
   static constexpr int DEPTH = 14;     // max depth of every position to be stored
   static constexpr double LOG_3 = 1.58496250072; // log2(3)
+  static constexpr size_t SIZE = next_prime(1 << BOOK_SIZE); // number of entries of the table
   TranspositionTable<uint_t<int((DEPTH + Position::WIDTH -1) * LOG_3) + 1 - BOOK_SIZE>, Position::position_t, uint8_t, BOOK_SIZE> *table =
     new TranspositionTable<uint_t<int((DEPTH + Position::WIDTH -1) * LOG_3) + 1 - BOOK_SIZE>, Position::position_t, uint8_t, BOOK_SIZE>();
+  uint8_t *moves = new uint8_t[SIZE](); // best move of each entry of the table, see OpeningBook
+  bool has_moves = false;
 
+  if(!record_files.empty()) {
+    long long stored = ingest_records(record_files, table, moves, SIZE, DEPTH, has_moves);
+    if(stored < 0) return 1;
+    std::cerr << stored << " records read" << std::endl;
+  }
   long long count = 1;
-  for(std::string line; getline(std::cin, line); count++) {
+  for(std::string line; record_files.empty() && getline(std::cin, line); count++) {
     if(line.length() == 0) break; // empty line = end of input
-    std::istringstream iss(line);
-    std::string pos;
-    getline(iss, pos, ' '); // read position before first space character
-    int score;
-    iss >> score;
-
     Position P;
-    if(iss.fail() || !iss.eof()
-        || P.play(pos) != pos.length()
-        || score < Position::MIN_SCORE || score > Position::MAX_SCORE) {  // a valid line is a position a space and a valid score
+    int score, move;
+    if(!parse_line(line, P, score, move)) {
       std::cerr << "Invalid line (line ignored): " << line << std::endl;
       continue;
     }
-    table->put(P.key3(), score - Position::MIN_SCORE + 1);
+    const uint64_t key = P.key3();
+    table->put(key, score - Position::MIN_SCORE + 1);
+    moves[table->locate(key)] = move; // also clears the move of an overwritten entry
+    has_moves |= move != 0;
     if(count % 1000000 == 0) std::cerr << count << std::endl;
   }
+  if(!has_moves) { // keep the original format
+    delete[] moves;
+    moves = 0;
+  }
 
-  OpeningBook book{Position::WIDTH, Position::HEIGHT, DEPTH, table};
+  OpeningBook book{Position::WIDTH, Position::HEIGHT, DEPTH, table, moves};
 
   std::ostringstream book_file;
   book_file << Position::WIDTH << "x" << Position::HEIGHT << ".book";
-  book.save(book_file.str());
+  return book.save(book_file.str()) ? 0 : 1;
 }
 
 /**
- * If used with a max depth parameter: generate all uniquepsoition upto max depth
+ * Add scored positions read from stdin to an existing opening book, without solving anything again.
+ *
+ * Input lines are parsed by parse_line(), a position already in the book gets the new score.
+ * The depth of the book grows to the deepest added position, and the table grows when the
+ * number of positions exceeds MAX_LOAD_FACTOR of its size. No position is lost: the ones whose
+ * entry of the table holds another position are stored in the deep line section, see OpeningBook::add.
+ * The new book replaces output_file atomically.
+ * @return 0 in case of success.
+ */
+int merge_opening_book(const std::string &book_file, const std::string &output_file) {
+  static constexpr double MAX_LOAD_FACTOR = 0.25; // colliding positions go to the deep line section, about 11% of them
+  static constexpr int MAX_LOG_SIZE = 27; // largest table supported by OpeningBook
+
+  struct Entry {
+    uint64_t key;
+    uint8_t value;
+    uint8_t move;
+  };
+  std::vector<Entry> entries;
+  std::vector<std::pair<Position::position_t, Entry>> deep; // deep line section, keyed by symmetricKey()
+  int depth, log_size;
+  {
+    OpeningBook old{Position::WIDTH, Position::HEIGHT};
+    old.load(book_file);
+    if(old.getDepth() < 0) return 1;
+    depth = old.getDepth();
+    log_size = log2(old.getSize());
+    old.forEach([&](uint64_t key, uint8_t value, uint8_t move) {entries.push_back(Entry{key, value, move});});
+    old.forEachDeep([&](Position::position_t key, uint8_t value, uint8_t move) {deep.emplace_back(key, Entry{0, value, move});});
+  }
+  std::vector<Entry> added;
+  long long count = 1;
+  for(std::string line; getline(std::cin, line); count++) {
+    if(line.length() == 0) break; // empty line = end of input
+    Position P;
+    int score, move;
+    if(!parse_line(line, P, score, move)) {
+      std::cerr << "Invalid line (line ignored): " << line << std::endl;
+      continue;
+    }
+    added.push_back(Entry{P.key3(), uint8_t(score - Position::MIN_SCORE + 1), uint8_t(move)});
+    if(P.nbMoves() > depth) depth = P.nbMoves();
+    if(count % 1000000 == 0) std::cerr << count << std::endl;
+  }
+
+  auto sort_unique = [&entries]() { // keep the last entry of each position
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {return a.key < b.key;});
+    size_t unique = 0;
+    for(size_t i = 0; i < entries.size(); i++) {
+      if(unique && entries[unique - 1].key == entries[i].key) entries[unique - 1] = entries[i];
+      else entries[unique++] = entries[i];
+    }
+    entries.resize(unique);
+  };
+
+  // deep positions now within the depth of the book are never probed in the deep section: they are
+  // moved to the table, before the entries of the table so that a stored best move is kept
+  const size_t table_count = entries.size();
+  size_t kept = 0;
+  for(const auto &e : deep) {
+    if(Position::nbMovesOfKey(e.first) <= depth) {
+      const Position P = Position::fromKey(e.first); // in the orientation of the symmetricKey, as the move
+      uint8_t move = e.second.move && P.isKey3Mirrored() ? Position::WIDTH + 1 - e.second.move : e.second.move;
+      entries.push_back(Entry{P.key3(), e.second.value, move});
+    }
+    else deep[kept++] = e;
+  }
+  deep.resize(kept);
+  const size_t folded = entries.size() - table_count;
+  std::rotate(entries.begin(), entries.begin() + table_count, entries.end());
+  sort_unique();
+  const size_t old_count = entries.size();
+
+  entries.insert(entries.end(), added.begin(), added.end()); // the added entries win
+  sort_unique();
+
+  while(log_size < MAX_LOG_SIZE && entries.size() > MAX_LOAD_FACTOR * (size_t(1) << log_size)) log_size++;
+  OpeningBook book{Position::WIDTH, Position::HEIGHT, depth, log_size};
+  if(book.getDepth() < 0) return 1;
+  size_t in_table = 0; // every position is kept: the ones colliding in the table go to the deep line section
+  for(const Entry &e : entries) in_table += book.add(e.key, e.value, e.move);
+  for(const auto &e : deep) book.putDeep(e.first, e.second.value, e.second.move);
+  size_t stored = 0;
+  book.forEach([&](uint64_t, uint8_t, uint8_t) {stored++;});
+  if(stored != in_table) {
+    std::cerr << "Inconsistent opening book: " << stored << " positions found in the table, " << in_table << " stored" << std::endl;
+    return 1;
+  }
+  if(!book.save(output_file)) return 1;
+  std::cerr << entries.size() << " positions (" << entries.size() - old_count << " new), depth " << depth
+            << ", size 2^" << log_size << ": " << stored << " in the table, " << book.getDeepSize() - deep.size()
+            << " colliding ones and " << deep.size() << " deep lines in the deep line section ("
+            << folded << " previous deep positions within depth), saved in " << output_file << std::endl;
+  return 0;
+}
+
+/**
+ * Solve the positions beyond the depth of a book that are the most frequent in a log of played
+ * games, and store them in the deep line section of the book, so that the searches of popular
+ * lines stop there.
+ *
+ * Games are read from stdin, one sequence of played columns (1-based) per line, until EOF or
+ * an empty line. A game is used up to its first invalid move.
+ * @param max_positions: max number of positions added to the deep line section.
+ * @param min_count: positions seen in less games are ignored.
+ * @return 0 in case of success.
+ */
+int add_deep_lines(const std::string &book_file, size_t max_positions, int min_count) {
+  std::shared_ptr<OpeningBook> book = std::make_shared<OpeningBook>(Position::WIDTH, Position::HEIGHT);
+  book->load(book_file);
+  if(book->getDepth() < 0) return 1;
+
+  std::unordered_map<Position::position_t, std::pair<int, Position>> counts; // symmetric key -> number of games, position
+  for(std::string line; getline(std::cin, line);) {
+    if(line.length() == 0) break; // empty line = end of input
+    Position P;
+    for(char c : line) {
+      int col = c - '1';
+      if(col < 0 || col >= Position::WIDTH || !P.canPlay(col) || P.isWinningMove(col)) break; // invalid move or end of game
+      P.playCol(col);
+      if(P.nbMoves() <= book->getDepth() || P.canWinNext()) continue; // already in book or never probed by the solver
+      auto &entry = counts.emplace(P.symmetricKey(), std::make_pair(0, P)).first->second;
+      entry.first++; // a game does not go through the same position twice
+    }
+  }
+
+  std::vector<std::pair<int, Position>> popular;
+  for(const auto &c : counts)
+    if(c.second.first >= min_count && !book->get(c.second.second)) popular.push_back(c.second);
+  std::sort(popular.begin(), popular.end(), [](const std::pair<int, Position> &a, const std::pair<int, Position> &b) {
+    return a.first > b.first;
+  });
+  if(popular.size() > max_positions) popular.resize(max_positions);
+  std::sort(popular.begin(), popular.end(), [](const std::pair<int, Position> &a, const std::pair<int, Position> &b) {
+    return a.second.nbMoves() > b.second.nbMoves(); // deepest first, their results speed up the shallower ones
+  });
+
+  Solver solver;
+  solver.setBook(book);
+  std::vector<std::pair<Position::position_t, uint8_t>> solved;
+  for(size_t i = 0; i < popular.size(); i++) {
+    const Position &P = popular[i].second;
+    solved.emplace_back(P.symmetricKey(), solver.solve(P) - Position::MIN_SCORE + 1);
+    if((i + 1) % 100 == 0) std::cerr << i + 1 << "/" << popular.size() << " positions solved" << std::endl;
+  }
+  for(const auto &s : solved) book->putDeep(s.first, s.second); // the book is left unchanged while solving
+  if(!book->save(book_file)) return 1;
+  std::cerr << solved.size() << " positions added, " << book->getDeepSize() << " deep positions saved in " << book_file << std::endl;
+  return 0;
+}
+
+/**
+ * If used with a max depth parameter: generate all uniquepsoition upto max depth, optionally followed by
+ *   the number of threads, the directory of the temporary files and the memory used for sorting (MB)
+ * If used with -m book_file [output_file]: merge scored positions from standard input in an existing opening book
+ * If used with -l book_file [max_positions [min_count]]: add the most played positions of the games from standard input
+ *   to the deep line section of an existing opening book
+ * If used with -r record_files...: read binary scored positions to store in an opening book
  * If no parameter: read scoredposition from standard input to store in an opening book
  */
 int main(int argc, char** argv) {
+  if(argc > 2 && std::string(argv[1]) == "-m") return merge_opening_book(argv[2], argc > 3 ? argv[3] : argv[2]);
+  if(argc > 2 && std::string(argv[1]) == "-l")
+    return add_deep_lines(argv[2], argc > 3 ? strtoull(argv[3], nullptr, 10) : 10000, argc > 4 ? atoi(argv[4]) : 2);
+  if(argc > 2 && std::string(argv[1]) == "-r") return generate_opening_book(std::vector<std::string>(argv + 2, argv + argc));
   if(argc > 1) {
     int depth = atoi(argv[1]);
-    char pos_str[depth + 1] = {0};
-    explore(Position(), pos_str, depth);
-  } else generate_opening_book();
+    if(depth < 0 || depth > Enumerator::MAX_DEPTH) {
+      std::cerr << "Invalid depth: " << depth << " (max " << Enumerator::MAX_DEPTH << ")" << std::endl;
+      return 1;
+    }
+    int threads = argc > 2 ? atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    Enumerator enumerator(depth, std::max(1, threads), argc > 3 ? argv[3] : "/tmp", argc > 4 ? strtoull(argv[4], nullptr, 10) : 1024);
+    if(!enumerator.run()) {
+      std::cerr << "Unable to write temporary files" << std::endl;
+      return 1;
+    }
+  } else return generate_opening_book({});
 }
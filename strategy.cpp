@@ -0,0 +1,161 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Solver.hpp"
+#include "StrategyTable.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace GameSolver::Connect4;
+
+static constexpr int BOARD_SIZE = Position::WIDTH * Position::HEIGHT;
+
+Solver solver;
+std::unordered_map<uint64_t, uint8_t> strategy; // symmetric key -> 1 + column in the orientation of the key
+
+// Column exploration order, starting with center columns
+int column(int i) {
+  return Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
+}
+
+/**
+ * Choose one move of the side in P, keeping the best reachable result,
+ * then explore all the replies of the opponent to this move.
+ * P is a position where the side has to play and the game is not over.
+ */
+void build(const Position &P) {
+  const Position::position_t key = P.key();
+  const Position::position_t mirror = P.mirrorKey();
+  if(!strategy.emplace(std::min(key, mirror), 0).second) return; // already explored position
+
+  int best = -1;
+  int bestScore = -2;
+  for(int i = 0; i < Position::WIDTH && bestScore < 1; i++) { // the first winning move is enough
+    const int col = column(i);
+    if(!P.canPlay(col)) continue;
+    if(P.isWinningMove(col)) {
+      best = col;
+      bestScore = 2; // the game ends
+      break;
+    }
+    Position P2(P);
+    P2.playCol(col);
+    int score = 0; // draw when the board is full
+    if(P2.nbMoves() < BOARD_SIZE) {
+      score = -solver.solve(P2, true); // only the result matters
+      score = (score > 0) - (score < 0);
+    }
+    if(score > bestScore) {
+      best = col;
+      bestScore = score;
+    }
+  }
+  strategy[std::min(key, mirror)] = 1 + (mirror < key ? Position::WIDTH - 1 - best : best);
+  if(strategy.size() % 100000 == 0) std::cerr << strategy.size() << " positions" << std::endl;
+  if(bestScore == 2) return;
+
+  Position P2(P);
+  P2.playCol(best);
+  if(P2.nbMoves() == BOARD_SIZE) return;
+  for(int col = 0; col < Position::WIDTH; col++) // all the replies of the opponent
+    if(P2.canPlay(col) && !P2.isWinningMove(col)) { // the opponent cannot win if the side does not lose
+      Position P3(P2);
+      P3.playCol(col);
+      if(P3.nbMoves() < BOARD_SIZE) build(P3);
+    }
+}
+
+/**
+ * Read positions from stdin and print the move of the strategy for each of them:
+ * the column to play (1-based), or "-" if the position is not covered by the strategy.
+ */
+int play(const std::string &strategy_file) {
+  StrategyTable table;
+  if(!table.load(strategy_file)) return 1;
+  for(std::string line; getline(std::cin, line);) {
+    Position P;
+    if(P.play(line) != line.length()) {
+      std::cout << "error invalid move " << P.nbMoves() + 1 << std::endl;
+      continue;
+    }
+    const int move = table.getMove(P);
+    if(move < 0) std::cout << "-" << std::endl;
+    else std::cout << move + 1 << std::endl;
+  }
+  return 0;
+}
+
+/**
+ * Export the perfect play strategy of the side to move in a root position, or play from an
+ * exported strategy.
+ *
+ * The side gets a single move in each of its positions, the opponent all its possible replies,
+ * so the size of the strategy mostly depends on the freedom left to the opponent. Exporting it
+ * from the empty board is only practical with an opening book, and a lot of time and memory.
+ * Moves are chosen with weak solves: a win is kept, otherwise a draw.
+ */
+int main(int argc, char** argv) {
+  std::string bookFile, endgameFile, playFile, root;
+  std::ostringstream default_file;
+  default_file << Position::WIDTH << "x" << Position::HEIGHT << ".strategy";
+  std::string output_file = default_file.str();
+  bool has_root = false;
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-b") && i + 1 < argc) bookFile = argv[++i];
+    else if(!strcmp(argv[i], "-t") && i + 1 < argc) endgameFile = argv[++i];
+    else if(!strcmp(argv[i], "-o") && i + 1 < argc) output_file = argv[++i];
+    else if(!strcmp(argv[i], "-p") && i + 1 < argc) playFile = argv[++i];
+    else if(argv[i][0] != '-' && !has_root) {
+      root = argv[i];
+      has_root = true;
+    } else {
+      std::cerr << "usage: " << argv[0] << " [-b book] [-t endgame_table] [-o output_file] root_moves" << std::endl
+                << "       " << argv[0] << " -p strategy_file < positions" << std::endl;
+      return 1;
+    }
+  }
+  if(!playFile.empty()) return play(playFile);
+
+  Position P;
+  if(P.play(root) != root.length() || P.nbMoves() == BOARD_SIZE) {
+    std::cerr << "Invalid root position: " << root << std::endl;
+    return 1;
+  }
+  if(!bookFile.empty()) solver.loadBook(bookFile);
+  if(!endgameFile.empty()) solver.loadEndgameTable(endgameFile);
+  if(solver.solve(P, true) < 0) {
+    std::cerr << "The side to move loses in the root position, there is no strategy to export" << std::endl;
+    return 1;
+  }
+  build(P);
+
+  std::vector<std::pair<uint64_t, uint8_t>> entries(strategy.begin(), strategy.end());
+  std::sort(entries.begin(), entries.end());
+  if(!MappedTable::save(output_file, Position::WIDTH, Position::HEIGHT, 1 + P.nbMoves() % 2, entries)) {
+    std::cerr << "Unable to write strategy: " << output_file << std::endl;
+    return 1;
+  }
+  std::cerr << entries.size() << " positions stored in " << output_file << std::endl;
+  return 0;
+}
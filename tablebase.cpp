@@ -0,0 +1,128 @@
+/*
+ * This file is part of Connect4 Game Solver <http://connect4.gamesolver.org>
+ * Copyright (C) 2017-2019 Pascal Pons <contact@gamesolver.org>
+ *
+ * Connect4 Game Solver is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Affero General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * Connect4 Game Solver is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Connect4 Game Solver. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Position.hpp"
+#include "MappedTable.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace GameSolver::Connect4;
+
+static constexpr int BOARD_SIZE = Position::WIDTH * Position::HEIGHT;
+
+std::unordered_set<uint64_t> visited;          // explored positions with too many empty cells to be stored
+std::unordered_map<uint64_t, int> scores;      // symmetric key -> exact score of stored positions
+std::vector<Position> layers[BOARD_SIZE + 1];  // positions to be stored, per number of played moves
+
+/**
+ * Explore all the positions reachable from P and collect the ones with
+ * at least min_moves played moves. Symetric positions are collected only once.
+ */
+void explore(const Position &P, const int min_moves) {
+  const uint64_t key = P.symmetricKey();
+  if(P.nbMoves() >= min_moves) {
+    if(!scores.emplace(key, 0).second) return; // already explored position
+    layers[P.nbMoves()].push_back(P);
+  }
+  else if(!visited.insert(key).second) return; // already explored position
+
+  for(int i = 0; i < Position::WIDTH; i++) // explore all possible moves
+    if(P.canPlay(i) && !P.isWinningMove(i)) {
+      Position P2(P);
+      P2.playCol(i);
+      explore(P2, min_moves);
+    }
+}
+
+/**
+ * Exact score of a collected position, all its non winning children must already be scored.
+ */
+int retrograde_score(const Position &P) {
+  if(P.nbMoves() == BOARD_SIZE) return 0; // draw game
+  int best = -BOARD_SIZE;
+  for(int i = 0; i < Position::WIDTH; i++)
+    if(P.canPlay(i)) {
+      if(P.isWinningMove(i)) return (BOARD_SIZE + 1 - P.nbMoves()) / 2;
+      Position P2(P);
+      P2.playCol(i);
+      int score = -scores.at(P2.symmetricKey());
+      if(score > best) best = score;
+    }
+  return best;
+}
+
+/**
+ * Generate an endgame table of all the positions having at most max_empty empty cells
+ * reachable from a set of seed positions.
+ *
+ * Seed positions are read from stdin, one per line, until EOF or an empty line.
+ * Enumerating every position reachable from the empty board is only practical for
+ * small boards, use seeds (e.g. positions of played games) for 7x6.
+ *
+ * Positions are scored backward, from the full board to the shallowest ones,
+ * each score being derived from the already known scores of the children,
+ * so no search is needed.
+ */
+int main(int argc, char** argv) {
+  if(argc < 2) {
+    std::cerr << "usage: " << argv[0] << " max_empty_cells [output_file] < seed_positions" << std::endl;
+    return 1;
+  }
+  const int max_empty = atoi(argv[1]);
+  if(max_empty < 0 || max_empty > BOARD_SIZE) {
+    std::cerr << "Invalid number of empty cells: " << max_empty << std::endl;
+    return 1;
+  }
+  std::ostringstream default_file;
+  default_file << Position::WIDTH << "x" << Position::HEIGHT << ".endgame";
+  const std::string output_file = argc > 2 ? argv[2] : default_file.str();
+  const int min_moves = BOARD_SIZE - max_empty;
+
+  for(std::string line; getline(std::cin, line);) {
+    if(line.length() == 0) break; // empty line = end of input
+    Position P;
+    if(P.play(line) != line.length()) {
+      std::cerr << "Invalid position (line ignored): " << line << std::endl;
+      continue;
+    }
+    explore(P, min_moves);
+  }
+  std::cerr << scores.size() << " positions collected" << std::endl;
+
+  for(int n = BOARD_SIZE; n >= min_moves; n--)
+    for(const Position &P : layers[n]) scores[P.symmetricKey()] = retrograde_score(P);
+
+  std::vector<std::pair<uint64_t, uint8_t>> entries;
+  for(int n = min_moves; n < BOARD_SIZE - 2; n++) // the solver directly scores the last two moves
+    for(const Position &P : layers[n])
+      if(!P.canWinNext() && P.possibleNonLosingMoves()) // other positions are never searched
+        entries.emplace_back(P.symmetricKey(), scores[P.symmetricKey()] - Position::MIN_SCORE + 1);
+  std::sort(entries.begin(), entries.end());
+
+  if(!MappedTable::save(output_file, Position::WIDTH, Position::HEIGHT, max_empty, entries)) {
+    std::cerr << "Unable to write endgame table: " << output_file << std::endl;
+    return 1;
+  }
+  std::cerr << entries.size() << " positions stored in " << output_file << std::endl;
+  return 0;
+}